@@ -4,7 +4,11 @@ namespace core {
 	namespace impl {
         IWriter* _customWriter = nullptr;
 		void set_color(console_color clr) {
+#ifdef _WIN32
 			SetConsoleTextAttribute(GetStdHandle(STD_OUTPUT_HANDLE), clr);
+#else
+			(void)clr;
+#endif
 		}
 	}
 
@@ -52,11 +52,11 @@ namespace core {
         }
 	}
 
-    static void set_writer(IWriter* wr) {
+    inline void set_writer(IWriter* wr) {
         impl::_customWriter = wr;
     }
 
-	static string inputline() {
+	inline string inputline() {
 		string line;
 		line.resize(80);
 		fgets(line.data(), 80, stdin);
@@ -0,0 +1,58 @@
+#include <core/io/mappedfile.hpp>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace core {
+	mappedfile::~mappedfile() {
+#ifdef _WIN32
+		if (mData)
+			UnmapViewOfFile(mData);
+		if (mMapping)
+			CloseHandle(mMapping);
+		if (mFile != INVALID_HANDLE_VALUE)
+			CloseHandle(mFile);
+#else
+		if (mData)
+			munmap((void*)mData, mDataLength);
+		if (mFd >= 0)
+			close(mFd);
+#endif
+	}
+
+	std::shared_ptr<mappedfile> mappedfile::Open(string_view filename) {
+		auto f = std::make_shared<mappedfile>();
+#ifdef _WIN32
+		f->mFile = CreateFileA(string(filename).c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (f->mFile == INVALID_HANDLE_VALUE)
+			return nullptr;
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(f->mFile, &size) || size.QuadPart == 0)
+			return nullptr;
+		f->mMapping = CreateFileMappingA(f->mFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!f->mMapping)
+			return nullptr;
+		f->mData = (const uint8_t*)MapViewOfFile(f->mMapping, FILE_MAP_READ, 0, 0, 0);
+		if (!f->mData)
+			return nullptr;
+		f->mDataLength = size_t(size.QuadPart);
+#else
+		f->mFd = open(string(filename).c_str(), O_RDONLY);
+		if (f->mFd < 0)
+			return nullptr;
+		struct stat st;
+		if (fstat(f->mFd, &st) != 0 || st.st_size == 0)
+			return nullptr;
+		void* p = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, f->mFd, 0);
+		if (p == MAP_FAILED)
+			return nullptr;
+		f->mData = (const uint8_t*)p;
+		f->mDataLength = size_t(st.st_size);
+#endif
+		return f;
+	}
+}
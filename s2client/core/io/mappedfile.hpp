@@ -0,0 +1,33 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+
+namespace core {
+	// Read-only memory mapping of a whole file. Pages are shared between processes that
+	// map the same file, and the mapping stays valid for the lifetime of the object.
+	class mappedfile {
+	private:
+#ifdef _WIN32
+		HANDLE mFile = INVALID_HANDLE_VALUE;
+		HANDLE mMapping = nullptr;
+#else
+		int mFd = -1;
+#endif
+		const uint8_t* mData = nullptr;
+		size_t mDataLength = 0;
+	public:
+		mappedfile() = default;
+		~mappedfile();
+		mappedfile(const mappedfile&) = delete;
+		mappedfile& operator=(const mappedfile&) = delete;
+
+		static std::shared_ptr<mappedfile> Open(string_view filename);
+
+		const uint8_t* data()const {
+			return mData;
+		}
+		size_t length()const {
+			return mDataLength;
+		}
+	};
+}
@@ -13,16 +13,25 @@
 #include <limits>
 #endif
 #include <cmath>
+#include <cstring>
 #include <type_traits>
 
+#ifdef _WIN32
 #include <WinSock2.h>
 #include <Ws2tcpip.h>
 #ifndef __clang__
 #include <intrin.h>
 #endif
 #include <direct.h>
+#else
+// MSVC intrinsics used across the tree.
+#define __forceinline inline
+#define __debugbreak() __builtin_trap()
+#endif
 
+#ifdef _WIN32
 #pragma comment(lib, "ws2_32.lib")
+#endif
 
 #ifndef __clang__
 #include <functional>
@@ -32,6 +41,7 @@
 #include <vector>
 #include <deque>
 #include <map>
+#include <unordered_map>
 #include <set>
 #include <array>
 #include <queue>
@@ -58,7 +68,7 @@ using std::string_view;
 #ifdef _DEBUG
 #include <assert.h>
 #else
-#define assert(...) ((void*)0)
+#define assert(...) ((void)0)
 #endif
 
 #undef max
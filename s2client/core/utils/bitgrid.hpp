@@ -0,0 +1,181 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <bit>
+
+namespace core {
+	// 2D grid of bits packed 64 cells per word. Every row starts on a fresh word, so row spans
+	// and rectangles are tested a word at a time, and tiles that are a multiple of 64 cells wide
+	// can be written from different threads without sharing words.
+	class bitgrid {
+		uint64_t* mWords = nullptr;
+		int mWidth = 0;
+		int mHeight = 0;
+		int mStride = 0;
+		bool mOwned = true;
+
+		void release() {
+			if (mWords && mOwned)
+				delete[] mWords;
+			mWords = nullptr;
+			mOwned = true;
+			mWidth = mHeight = mStride = 0;
+		}
+		// Bits lo..hi (inclusive) of a word.
+		static uint64_t spanmask(int lo, int hi) {
+			return (~0ull << lo) & (~0ull >> (63 - hi));
+		}
+		template<typename Fn>
+		void forspan(int y, int x0, int x1, Fn&& fn)const {
+			const uint64_t* row = mWords + size_t(y) * mStride;
+			int w0 = x0 >> 6, w1 = x1 >> 6;
+			for (int w = w0; w <= w1; w++) {
+				int lo = (w == w0) ? (x0 & 63) : 0;
+				int hi = (w == w1) ? (x1 & 63) : 63;
+				if (fn(row[w] & spanmask(lo, hi)))
+					return;
+			}
+		}
+	public:
+		static size_t WordsFor(int width, int height) {
+			return size_t((width + 63) >> 6) * height;
+		}
+
+		bitgrid() = default;
+		bitgrid(const bitgrid& o) {
+			*this = o;
+		}
+		bitgrid(bitgrid&& o) noexcept {
+			*this = std::move(o);
+		}
+		~bitgrid() {
+			release();
+		}
+		bitgrid& operator=(const bitgrid& o) {
+			if (this != &o) {
+				initialize(o.mWidth, o.mHeight);
+				std::copy(o.mWords, o.mWords + numwords(), mWords);
+			}
+			return *this;
+		}
+		bitgrid& operator=(bitgrid&& o) noexcept {
+			if (this != &o) {
+				release();
+				mWords = o.mWords; mOwned = o.mOwned;
+				mWidth = o.mWidth; mHeight = o.mHeight; mStride = o.mStride;
+				o.mWords = nullptr; o.mOwned = true;
+				o.mWidth = o.mHeight = o.mStride = 0;
+			}
+			return *this;
+		}
+
+		// Allocates a cleared grid.
+		void initialize(int width, int height) {
+			release();
+			mWidth = width; mHeight = height;
+			mStride = (width + 63) >> 6;
+			mWords = new uint64_t[WordsFor(width, height)]();
+		}
+		// Non-owning, read-only view over WordsFor(width, height) external words.
+		void view(const uint64_t* words, int width, int height) {
+			release();
+			mWidth = width; mHeight = height;
+			mStride = (width + 63) >> 6;
+			mWords = const_cast<uint64_t*>(words);
+			mOwned = false;
+		}
+
+		int width()const { return mWidth; }
+		int height()const { return mHeight; }
+		// Words per row.
+		int stride()const { return mStride; }
+		size_t numwords()const { return size_t(mStride) * mHeight; }
+		const uint64_t* words()const { return mWords; }
+		const uint64_t* row(int y)const { return mWords + size_t(y) * mStride; }
+		bool contains(int x, int y)const { return x >= 0 && y >= 0 && x < mWidth && y < mHeight; }
+
+		bool get(int x, int y)const {
+			assert(contains(x, y));
+			return (mWords[size_t(y) * mStride + (x >> 6)] >> (x & 63)) & 1;
+		}
+		void set(int x, int y, bool value) {
+			assert(contains(x, y));
+			uint64_t& word = mWords[size_t(y) * mStride + (x >> 6)];
+			uint64_t bit = 1ull << (x & 63);
+			word = value ? (word | bit) : (word & ~bit);
+		}
+
+		// Span and rectangle queries take inclusive bounds and clip them to the grid.
+		bool anyinrow(int y, int x0, int x1)const {
+			if (y < 0 || y >= mHeight)
+				return false;
+			x0 = max(x0, 0); x1 = min(x1, mWidth - 1);
+			bool any = false;
+			if (x0 <= x1)
+				forspan(y, x0, x1, [&](uint64_t bits) { return any = bits != 0; });
+			return any;
+		}
+		int countinrow(int y, int x0, int x1)const {
+			if (y < 0 || y >= mHeight)
+				return 0;
+			x0 = max(x0, 0); x1 = min(x1, mWidth - 1);
+			int count = 0;
+			if (x0 <= x1)
+				forspan(y, x0, x1, [&](uint64_t bits) { count += std::popcount(bits); return false; });
+			return count;
+		}
+		bool anyinrect(int x0, int y0, int x1, int y1)const {
+			for (int y = max(y0, 0); y <= min(y1, mHeight - 1); y++) {
+				if (anyinrow(y, x0, x1))
+					return true;
+			}
+			return false;
+		}
+		int countinrect(int x0, int y0, int x1, int y1)const {
+			int count = 0;
+			for (int y = max(y0, 0); y <= min(y1, mHeight - 1); y++)
+				count += countinrow(y, x0, x1);
+			return count;
+		}
+		void setrect(int x0, int y0, int x1, int y1, bool value) {
+			x0 = max(x0, 0); x1 = min(x1, mWidth - 1);
+			if (x0 > x1)
+				return;
+			for (int y = max(y0, 0); y <= min(y1, mHeight - 1); y++) {
+				uint64_t* row = mWords + size_t(y) * mStride;
+				int w0 = x0 >> 6, w1 = x1 >> 6;
+				for (int w = w0; w <= w1; w++) {
+					uint64_t mask = spanmask((w == w0) ? (x0 & 63) : 0, (w == w1) ? (x1 & 63) : 63);
+					row[w] = value ? (row[w] | mask) : (row[w] & ~mask);
+				}
+			}
+		}
+		void clear() {
+			std::fill(mWords, mWords + numwords(), 0ull);
+		}
+
+		// Bulk combination of same-sized grids; plain loops over contiguous words, which the
+		// compiler vectorises. Padding bits past the width stay clear as long as both sides' do.
+		bitgrid& operator|=(const bitgrid& o) {
+			assert(o.mWidth == mWidth && o.mHeight == mHeight);
+			size_t n = numwords();
+			for (size_t i = 0; i < n; i++)
+				mWords[i] |= o.mWords[i];
+			return *this;
+		}
+		bitgrid& operator&=(const bitgrid& o) {
+			assert(o.mWidth == mWidth && o.mHeight == mHeight);
+			size_t n = numwords();
+			for (size_t i = 0; i < n; i++)
+				mWords[i] &= o.mWords[i];
+			return *this;
+		}
+		bitgrid& andnot(const bitgrid& o) {
+			assert(o.mWidth == mWidth && o.mHeight == mHeight);
+			size_t n = numwords();
+			for (size_t i = 0; i < n; i++)
+				mWords[i] &= ~o.mWords[i];
+			return *this;
+		}
+	};
+}
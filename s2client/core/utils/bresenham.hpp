@@ -69,6 +69,43 @@ namespace core {
 		}
 	};
 
+	// Visits the cells of the bresenham line from (x0, y0) to (x1, y1), endpoints included, as
+	// runs along the major axis instead of one cell at a time: fn(minor, from, to) with from..to
+	// inclusive on the major axis, in walking order (from > to when walking backwards). x is the
+	// major axis when abs(x1 - x0) >= abs(y1 - y0). Stops as soon as fn returns true and returns
+	// whether it did.
+	template<typename Fn>
+	bool bresenhamruns(int x0, int y0, int x1, int y1, Fn&& fn) {
+		int dx = abs(x1 - x0);
+		int dy = abs(y1 - y0);
+		int sx = (x0 < x1) ? 1 : -1;
+		int sy = y0 < y1 ? 1 : -1;
+		bool xmajor = dx >= dy;
+		int major = xmajor ? x0 : y0, majorend = xmajor ? x1 : y1, smajor = xmajor ? sx : sy;
+		int minor = xmajor ? y0 : x0, minorend = xmajor ? y1 : x1, sminor = xmajor ? sy : sx;
+		int da = xmajor ? dx : dy, db = xmajor ? dy : dx;
+		if (db == 0)
+			return fn(minor, major, majorend);
+		// Each run is k + 1 cells, k = ceil(n / d) for n > 0 and 0 otherwise, where n tracks the
+		// error term. After a run n lands in a window one d wide, so the next k is one of two
+		// neighbouring values and the division is only needed up front.
+		int d = 2 * db;
+		int n = da - 2 * db;
+		int step = 2 * da - d;
+		int kstep = step > 0 ? (step + d - 1) / d : 0;
+		int k = n > 0 ? (n + d - 1) / d : 0;
+		while (minor != minorend) {
+			int runend = major + k * smajor;
+			if (fn(minor, major, runend))
+				return true;
+			major = runend + smajor;
+			minor += sminor;
+			n += step - k * d;
+			k = n <= 0 ? 0 : (n > (kstep - 1) * d ? kstep : kstep - 1);
+		}
+		return fn(minor, major, majorend);
+	}
+
 	std::pair<int, int> bresenham_next(int x0, int y0, int x1, int y1) {
 		int dx = abs(x1 - x0);
 		int sx = (x0 < x1) ? 1 : -1;
@@ -1,6 +1,6 @@
 #pragma once
 
-#pragma once
+#include <core/prerequisites.hpp>
 #include <cstdint>
 #include <limits>
 #include <type_traits>
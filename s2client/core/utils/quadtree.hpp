@@ -154,13 +154,20 @@ namespace core {
 			mCount++;
 		}
 
-		vector<TVal*> query(const rect& area) {
+		vector<TVal*> query(const rect& area)const {
 			vector<TVal*> results;
-			vector<node*> nodes;
-			nodes.push_back(&mRoot);
-			while (!nodes.empty()) {
-				node* current = nodes.back();
-				nodes.pop_back();
+			query(area, results);
+			return results;
+		}
+
+		// Same as above but reuses the caller's buffer, so repeated queries don't allocate.
+		void query(const rect& area, vector<TVal*>& results)const {
+			results.clear();
+			const node* stack[128];
+			int depth = 0;
+			stack[depth++] = &mRoot;
+			while (depth > 0) {
+				const node* current = stack[--depth];
 				if (current->bounds.intersects(area)) {
 					if (current->leaf()) {
 						for (auto& e : current->vals) {
@@ -173,14 +180,14 @@ namespace core {
 						}
 					}
 					else {
-						nodes.push_back(current->nw);
-						nodes.push_back(current->ne);
-						nodes.push_back(current->se);
-						nodes.push_back(current->sw);
+						assert(depth + 4 <= 128);
+						stack[depth++] = current->nw;
+						stack[depth++] = current->ne;
+						stack[depth++] = current->se;
+						stack[depth++] = current->sw;
 					}
 				}
 			}
-			return results;
 		}
 
 		void clear() {
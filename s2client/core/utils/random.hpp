@@ -9,8 +9,8 @@ namespace core {
 			static random _Instance;
 			return _Instance;
 		}
-		std::mt19937_64 mGen;
 		std::random_device mRd;
+		std::mt19937_64 mGen;
 
 		random() : mRd(), mGen(mRd()) {
 		}
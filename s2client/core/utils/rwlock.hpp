@@ -0,0 +1,33 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <mutex>
+#include <shared_mutex>
+
+namespace core {
+	// Reader-writer lock that a steady stream of readers can't starve a writer on: readers pass
+	// through a turnstile that a waiting writer holds until it gets in. std::shared_mutex makes no
+	// such promise, and glibc's prefers readers. Usable with std::shared_lock and std::unique_lock;
+	// a thread must not take it shared twice, as a writer may be queued in between.
+	class rwlock {
+		std::mutex mTurnstile;
+		std::shared_mutex mLock;
+	public:
+		void lock() {
+			std::lock_guard<std::mutex> gate(mTurnstile);
+			mLock.lock();
+		}
+		void unlock() {
+			mLock.unlock();
+		}
+		void lock_shared() {
+			{
+				std::lock_guard<std::mutex> gate(mTurnstile);
+			}
+			mLock.lock_shared();
+		}
+		void unlock_shared() {
+			mLock.unlock_shared();
+		}
+	};
+}
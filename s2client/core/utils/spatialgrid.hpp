@@ -0,0 +1,100 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <core/utils/quadtree.hpp>
+#include <span>
+
+namespace core {
+	// Static uniform grid over [0, width) x [0, height), built in one pass from a fixed set of
+	// rects. Cells list their items in one CSR array and item bounds are kept as separate
+	// min/max arrays, so a query touches a few contiguous runs of memory and never allocates.
+	// Rects that don't overlap the grid area are dropped, like quadtree::insert does.
+	template<class TVal>
+	class spatialgrid {
+	public:
+		struct item {
+			rect bounds;
+			TVal* val;
+		};
+	private:
+		float mCellSize = 1.f;
+		int mCellsX = 0, mCellsY = 0;
+		// Items of cell i are mCellItems[mCellOffsets[i] .. mCellOffsets[i+1]).
+		vector<uint32_t> mCellOffsets;
+		vector<uint32_t> mCellItems;
+		vector<float> mMinX, mMinY, mMaxX, mMaxY;
+		vector<TVal*> mVals;
+
+		int cellx(float x)const { return max(0, min(mCellsX - 1, int(x / mCellSize))); }
+		int celly(float y)const { return max(0, min(mCellsY - 1, int(y / mCellSize))); }
+	public:
+		spatialgrid() = default;
+		spatialgrid(float width, float height, float cellSize, std::span<const item> items) {
+			build(width, height, cellSize, items);
+		}
+
+		void build(float width, float height, float cellSize, std::span<const item> items) {
+			mCellSize = cellSize;
+			mCellsX = max(1, int(std::ceil(width / cellSize)));
+			mCellsY = max(1, int(std::ceil(height / cellSize)));
+			mMinX.clear(); mMinY.clear(); mMaxX.clear(); mMaxY.clear(); mVals.clear();
+			rect area(0.f, 0.f, width, height);
+			for (auto& it : items) {
+				if (!area.intersects(it.bounds))
+					continue;
+				mMinX.push_back(it.bounds.x);
+				mMinY.push_back(it.bounds.y);
+				mMaxX.push_back(it.bounds.x + it.bounds.w);
+				mMaxY.push_back(it.bounds.y + it.bounds.h);
+				mVals.push_back(it.val);
+			}
+
+			// Count, prefix sum, fill.
+			mCellOffsets.assign(size_t(mCellsX) * mCellsY + 1, 0);
+			auto forcells = [&](size_t i, auto&& fn) {
+				for (int cy = celly(mMinY[i]); cy <= celly(mMaxY[i]); cy++) {
+					for (int cx = cellx(mMinX[i]); cx <= cellx(mMaxX[i]); cx++)
+						fn(size_t(cy) * mCellsX + cx);
+				}
+			};
+			for (size_t i = 0; i < mVals.size(); i++)
+				forcells(i, [&](size_t c) { mCellOffsets[c + 1]++; });
+			for (size_t c = 1; c < mCellOffsets.size(); c++)
+				mCellOffsets[c] += mCellOffsets[c - 1];
+			mCellItems.resize(mCellOffsets.back());
+			vector<uint32_t> fill(mCellOffsets.begin(), mCellOffsets.end() - 1);
+			for (size_t i = 0; i < mVals.size(); i++)
+				forcells(i, [&](size_t c) { mCellItems[fill[c]++] = uint32_t(i); });
+		}
+
+		size_t size()const { return mVals.size(); }
+		float cellsize()const { return mCellSize; }
+
+		// Calls fn(TVal*) once for every item whose bounds intersect area (same test as
+		// rect::intersects), stopping early if fn returns true. Returns whether it stopped.
+		template<typename Fn>
+		bool visit(const rect& area, Fn&& fn)const {
+			if (mVals.empty())
+				return false;
+			float qx0 = area.x, qy0 = area.y, qx1 = area.x + area.w, qy1 = area.y + area.h;
+			int cx0 = cellx(qx0), cy0 = celly(qy0), cx1 = cellx(qx1), cy1 = celly(qy1);
+			for (int cy = cy0; cy <= cy1; cy++) {
+				for (int cx = cx0; cx <= cx1; cx++) {
+					size_t c = size_t(cy) * mCellsX + cx;
+					for (uint32_t k = mCellOffsets[c]; k < mCellOffsets[c + 1]; k++) {
+						uint32_t i = mCellItems[k];
+						if (qx0 >= mMaxX[i] || mMinX[i] >= qx1 || qy0 >= mMaxY[i] || mMinY[i] >= qy1)
+							continue;
+						// An item spanning several cells is reported only from the first cell
+						// it shares with the query.
+						if (cx != max(cx0, cellx(mMinX[i])) || cy != max(cy0, celly(mMinY[i])))
+							continue;
+						if (fn(mVals[i]))
+							return true;
+					}
+				}
+			}
+			return false;
+		}
+	};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+
+namespace core {
+	class threadpool {
+		vector<std::thread> mWorkers;
+		deque<std::function<void()>> mTasks;
+		std::mutex mMutex;
+		std::condition_variable mCv;
+		bool mStopping = false;
+
+		void work() {
+			while (true) {
+				std::function<void()> task;
+				{
+					std::unique_lock<std::mutex> lock(mMutex);
+					mCv.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+					if (mTasks.empty())
+						return;
+					task = std::move(mTasks.front());
+					mTasks.pop_front();
+				}
+				task();
+			}
+		}
+	public:
+		threadpool(int numThreads = 0) {
+			if (numThreads <= 0)
+				numThreads = max(1, int(std::thread::hardware_concurrency()));
+			mWorkers.reserve(numThreads);
+			for (int i = 0; i < numThreads; i++)
+				mWorkers.emplace_back([this] { work(); });
+		}
+		~threadpool() {
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mStopping = true;
+			}
+			mCv.notify_all();
+			for (auto& w : mWorkers)
+				w.join();
+		}
+		threadpool(const threadpool&) = delete;
+		threadpool& operator=(const threadpool&) = delete;
+
+		static threadpool& Instance() {
+			static threadpool _Instance;
+			return _Instance;
+		}
+
+		int size()const { return int(mWorkers.size()); }
+
+		template<typename Fn, typename R = std::invoke_result_t<Fn>>
+		std::future<R> submit(Fn&& fn) {
+			auto task = std::make_shared<std::packaged_task<R()>>(std::forward<Fn>(fn));
+			auto result = task->get_future();
+			{
+				std::lock_guard<std::mutex> lock(mMutex);
+				mTasks.emplace_back([task] { (*task)(); });
+			}
+			mCv.notify_one();
+			return result;
+		}
+
+		// Runs fn(item, worker) for every item in [0, count) and blocks until all are done.
+		// Items are handed out dynamically; 'worker' is in [0, min(size(), count)) and is
+		// stable for the duration of a call, so it can index per-worker scratch buffers.
+		// Must not be called from inside a task running on the same pool.
+		template<typename Fn>
+		void parallel_for(int count, Fn&& fn) {
+			if (count <= 0)
+				return;
+			int nworkers = min(size(), count);
+			if (nworkers == 1) {
+				for (int i = 0; i < count; i++)
+					fn(i, 0);
+				return;
+			}
+			std::atomic<int> next = 0;
+			vector<std::future<void>> pending;
+			pending.reserve(nworkers);
+			for (int w = 0; w < nworkers; w++) {
+				pending.push_back(submit([&next, &fn, count, w] {
+					for (int i = next++; i < count; i = next++)
+						fn(i, w);
+				}));
+			}
+			for (auto& p : pending)
+				p.get();
+		}
+	};
+}
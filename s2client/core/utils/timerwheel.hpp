@@ -0,0 +1,90 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+
+namespace core {
+	// Hashed timing wheel over an abstract tick count. Scheduling and cancelling are O(1); a timer
+	// sits in slot (deadline % slots) and is skipped until the wheel comes round to its deadline,
+	// so advancing costs one slot visit per elapsed tick plus the timers in those slots. Not
+	// thread-safe.
+	class timerwheel {
+	public:
+		using timerid = uint64_t;
+	private:
+		struct timer {
+			uint64_t deadline;
+			uint64_t period;
+			std::function<void()> fn;
+		};
+		vector<vector<timerid>> mSlots;
+		unordered_map<timerid, timer> mTimers;
+		uint64_t mCurrent = 0;
+		timerid mNextId = 1;
+
+		vector<timerid>& slot(uint64_t tick) { return mSlots[tick % mSlots.size()]; }
+	public:
+		timerwheel(uint64_t now = 0, size_t slots = 512)
+			: mSlots(slots), mCurrent(now) {
+		}
+
+		size_t size()const { return mTimers.size(); }
+
+		// Runs fn once delay ticks after now, then every period ticks if period is nonzero. now may
+		// be ahead of the last advance(); the wheel catches up on the next one.
+		timerid schedule(uint64_t now, uint64_t delay, std::function<void()> fn, uint64_t period = 0) {
+			timerid id = mNextId++;
+			uint64_t deadline = max(mCurrent, now) + max<uint64_t>(delay, 1);
+			mTimers.emplace(id, timer{ deadline, period, std::move(fn) });
+			slot(deadline).push_back(id);
+			return id;
+		}
+		// Returns whether the timer was still pending. Its slot entry is dropped lazily.
+		bool cancel(timerid id) {
+			return mTimers.erase(id) > 0;
+		}
+
+		// Moves the wheel forward to now and appends the callbacks of every timer that came due,
+		// rescheduling periodic ones for their next period after now. Callers run them afterwards,
+		// so the callbacks may schedule and cancel freely.
+		void advance(uint64_t now, vector<std::function<void()>>& due) {
+			// Past a full turn every slot gets visited anyway.
+			uint64_t from = max(mCurrent + 1, now >= mSlots.size() ? now - mSlots.size() + 1 : 0);
+			for (uint64_t tick = from; tick <= now; tick++) {
+				auto& ids = slot(tick);
+				for (size_t i = 0; i < ids.size();) {
+					auto it = mTimers.find(ids[i]);
+					if (it != mTimers.end() && it->second.deadline > now) {
+						i++;
+						continue;
+					}
+					timerid id = ids[i];
+					ids[i] = ids.back();
+					ids.pop_back();
+					if (it == mTimers.end())
+						continue;
+					due.push_back(it->second.fn);
+					if (it->second.period) {
+						it->second.deadline = max(it->second.deadline + it->second.period, now + 1);
+						slot(it->second.deadline).push_back(id);
+					}
+					else {
+						mTimers.erase(it);
+					}
+				}
+			}
+			mCurrent = max(mCurrent, now);
+		}
+
+		// Ticks from the current one to the next occupied slot, or -1 with no timers pending. A
+		// slot can hold timers for later turns, so this is a lower bound on the next expiry.
+		int64_t nextdue()const {
+			if (mTimers.empty())
+				return -1;
+			for (uint64_t d = 1; d <= mSlots.size(); d++) {
+				if (!mSlots[(mCurrent + d) % mSlots.size()].empty())
+					return int64_t(d);
+			}
+			return int64_t(mSlots.size());
+		}
+	};
+}
@@ -1,9 +1,11 @@
 #include <stdio.h>
+#include <filesystem>
 #include <core/prerequisites.hpp>
 #include <core/utils/input.hpp>
 #include <core/io/logger.hpp>
 #include <network/network.hpp>
 #include <network/httpclient.hpp>
+#include <network/reactor.hpp>
 #include <s2/resourcemanager.hpp>
 #include <s2/masterserver.hpp>
 #include <s2/userclient.hpp>
@@ -21,6 +23,7 @@
 #include <core/math/matrix.hpp>
 #include <core/math/geom.hpp>
 #include <core/io/zipfile.hpp>
+#include <core/utils/spatialgrid.hpp>
 #include <s2/model.hpp>
 #include <s2/iowriter.hpp>
 
@@ -120,10 +123,13 @@ void UIThread(s2::userclient* client) {
             auto clientinfo = client->clientinfo();
             auto local = client->localent();
             if (client->ingame() && clientinfo.ping && local) {
-                auto title = core::format("map \"%s\"; cid %d; health %.2f; team %d; status %d; recvd %d; sent %d;",
+                auto io = client->iostats();
+                auto rel = client->reliability();
+                auto title = core::format("map \"%s\"; cid %d; health %.2f; team %d; status %d; recvd %d; sent %d; batch rx %.2f tx %.2f; rtt %.0fms rto %.0fms inflight %d/%d rtx %d;",
                     client->currentworld() ? client->currentworld()->name() : "none",
                     clientinfo.clientNumber, local->m_fHealth, local->m_iTeam, local->m_yStatus,
-                    client->recvdsnapshots(), client->sentsnapshots());
+                    client->recvdsnapshots(), client->sentsnapshots(), io.avgrecvbatch(), io.avgsendbatch(),
+                    rel.srttMs, rel.rtoMs, rel.inflight, rel.window, rel.retransmits);
                 SetConsoleTitleA(title.c_str());
 
                 static bool drawnavmesh = false;
@@ -225,7 +231,7 @@ void UIThread(s2::userclient* client) {
                             auto stronghold = strongholds.back();
                             auto lair = lairs.back();
                             auto target = ((me->m_v3Position - stronghold->m_v3Position).length() > (me->m_v3Position - lair->m_v3Position).length()) ? stronghold : lair;
-                            client->pathtowards(target->m_v3Position, 825.f);
+                            client->flowtowards(*target, 825.f);
                         }
                     }
                 }
@@ -350,6 +356,20 @@ void DisplayModel(core::glrenderer& gfx, core::window& wnd, std::shared_ptr<s2::
     } while (0 == (GetAsyncKeyState(VK_RETURN) & 1));
 }
 
+// The first map in maps/, for the benchmarks in main.
+std::shared_ptr<s2::world> loadbenchmarkworld() {
+    std::shared_ptr<s2::world> world;
+    for (auto& entry : std::filesystem::directory_iterator("maps")) {
+        if (entry.path().extension() == ".s2z") {
+            world = s2::world::LoadFromFile(entry.path().string());
+            break;
+        }
+    }
+    if (!world)
+        core::error("No map to benchmark in maps/\n");
+    return world;
+}
+
 int main(int argc, char** argv) {
     core::info("Hello :o\n");
     network::init();
@@ -558,6 +578,231 @@ int main(int argc, char** argv) {
         }
     }
 
+    // batch pathfinding benchmark: paths/sec vs. pool size on the first map in maps/
+    if (false) {
+        auto world = loadbenchmarkworld();
+
+        const int numQueries = 256;
+        auto randompos = [&]() {
+            return vector3f(float(core::random::uint32(uint32_t(world->worldsize()))), float(core::random::uint32(uint32_t(world->worldsize()))), 0.f);
+        };
+        vector<s2::pathrequest> requests;
+        while (requests.size() < numQueries) {
+            auto from = randompos();
+            auto to = randompos();
+            if (world->isblocked(from.x, from.y) || world->isblocked(to.x, to.y))
+                continue;
+            requests.push_back(s2::pathrequest{ .from = from, .to = to });
+        }
+
+        int maxThreads = max(1, int(std::thread::hardware_concurrency()));
+        vector<int> threadCounts;
+        for (int threads = 1; threads < maxThreads; threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(maxThreads);
+        for (auto mode : { s2::pathmode::flat, s2::pathmode::hierarchical }) {
+            for (auto& request : requests)
+                request.mode = mode;
+            for (int threads : threadCounts) {
+                core::threadpool pool(threads);
+                auto start = std::chrono::high_resolution_clock::now();
+                int found = 0;
+                for (auto& path : world->pathfind_batch(requests, pool))
+                    found += path.get().empty() ? 0 : 1;
+                double secs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+                core::info("%s %2d threads: %d paths (%d found) in %.2fs, %.1f paths/sec\n",
+                    mode == s2::pathmode::flat ? "flat" : "hierarchical", threads, numQueries, found, secs, numQueries / secs);
+            }
+        }
+        getc(stdin);
+    }
+
+    // path smoothing benchmark: waypoint reduction and time cost of world::smoothpath
+    if (false) {
+        auto world = loadbenchmarkworld();
+
+        const int numQueries = 256;
+        auto randompos = [&]() {
+            return vector3f(float(core::random::uint32(uint32_t(world->worldsize()))), float(core::random::uint32(uint32_t(world->worldsize()))), 0.f);
+        };
+        for (auto mode : { s2::pathmode::flat, s2::pathmode::hierarchical }) {
+            size_t before = 0, after = 0;
+            double lengthBefore = 0.0, lengthAfter = 0.0, searchMs = 0.0, smoothMs = 0.0;
+            auto length = [](const deque<vector3f>& path) {
+                double total = 0.0;
+                for (size_t i = 1; i < path.size(); i++)
+                    total += (path[i] - path[i - 1]).length();
+                return total;
+            };
+            for (int i = 0; i < numQueries; i++) {
+                auto from = randompos(), to = randompos();
+                int refined = 0;
+                auto start = std::chrono::high_resolution_clock::now();
+                auto path = world->pathfind(from, to, nullptr, mode, &refined);
+                auto searched = std::chrono::high_resolution_clock::now();
+                before += path.size();
+                lengthBefore += length(path);
+                world->smoothpath(path, &refined);
+                auto smoothed = std::chrono::high_resolution_clock::now();
+                after += path.size();
+                lengthAfter += length(path);
+                searchMs += std::chrono::duration<double, std::milli>(searched - start).count();
+                smoothMs += std::chrono::duration<double, std::milli>(smoothed - searched).count();
+            }
+            core::info("%s: %zu -> %zu waypoints, length %.0f -> %.0f; search %.3fms, smoothing %.3fms per path\n",
+                mode == s2::pathmode::flat ? "flat" : "hierarchical", before, after, lengthBefore, lengthAfter,
+                searchMs / numQueries, smoothMs / numQueries);
+        }
+        getc(stdin);
+    }
+
+    // spatial index benchmark: core::quadtree vs. core::spatialgrid on random rects
+    if (false) {
+        struct item {
+            int id;
+        };
+        const float size = 32768.f;
+        const int numItems = 2000;
+        vector<item> items(numItems);
+        vector<core::spatialgrid<item>::item> bounds;
+        for (int i = 0; i < numItems; i++) {
+            float extent = float(core::random::int32(20, 120));
+            items[i].id = i;
+            bounds.push_back({ core::rect(float(core::random::uint32(uint32_t(size))), float(core::random::uint32(uint32_t(size))), extent, extent), &items[i] });
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        core::quadtree<item> qt(size, size, 50.f);
+        for (auto& b : bounds)
+            qt.insert(b.bounds, b.val);
+        auto built = std::chrono::high_resolution_clock::now();
+        core::spatialgrid<item> grid(size, size, 128.f, bounds);
+        auto gridBuilt = std::chrono::high_resolution_clock::now();
+        core::info("build: quadtree %.3fms, grid %.3fms\n",
+            std::chrono::duration<double, std::milli>(built - start).count(), std::chrono::duration<double, std::milli>(gridBuilt - built).count());
+
+        for (float extent : { 72.f, 1024.f }) {
+            const int numQueries = 100000;
+            vector<core::rect> queries;
+            for (int i = 0; i < numQueries; i++)
+                queries.push_back(core::rect(float(core::random::uint32(uint32_t(size))), float(core::random::uint32(uint32_t(size))), extent, extent));
+            vector<item*> results;
+            size_t qtFound = 0, gridFound = 0;
+            start = std::chrono::high_resolution_clock::now();
+            for (auto& q : queries) {
+                qt.query(q, results);
+                qtFound += results.size();
+            }
+            auto qtDone = std::chrono::high_resolution_clock::now();
+            for (auto& q : queries)
+                grid.visit(q, [&](item*) { gridFound++; return false; });
+            auto gridDone = std::chrono::high_resolution_clock::now();
+            core::info("%.0f-unit queries: quadtree %zu results in %.1fns/query, grid %zu results in %.1fns/query\n", extent,
+                qtFound, std::chrono::duration<double, std::nano>(qtDone - start).count() / numQueries,
+                gridFound, std::chrono::duration<double, std::nano>(gridDone - qtDone).count() / numQueries);
+        }
+        getc(stdin);
+    }
+
+    // line-of-sight benchmark: rays/sec for navmesh-length and long rays, one at a time vs. batched
+    if (false) {
+        auto world = loadbenchmarkworld();
+
+        const int numRays = 1 << 20;
+        const int batchSize = 72;
+        for (float maxLength : { 128.f, 2048.f }) {
+            vector<float> x0(numRays), y0(numRays), x1(numRays), y1(numRays);
+            for (int i = 0; i < numRays; i++) {
+                x0[i] = float(core::random::uint32(uint32_t(world->worldsize())));
+                y0[i] = float(core::random::uint32(uint32_t(world->worldsize())));
+                x1[i] = x0[i] + (core::random::uint32(uint32_t(2 * maxLength)) - maxLength);
+                y1[i] = y0[i] + (core::random::uint32(uint32_t(2 * maxLength)) - maxLength);
+            }
+            vector<char> single(numRays);
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < numRays; i++)
+                single[i] = world->testlineobstructed(x0[i], y0[i], x1[i], y1[i]);
+            double singleSecs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            std::unique_ptr<bool[]> batched(new bool[numRays]);
+            start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < numRays; i += batchSize)
+                world->testlinesobstructed(&x0[i], &y0[i], &x1[i], &y1[i], min(batchSize, numRays - i), &batched[i]);
+            double batchSecs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+            int blocked = 0, mismatches = 0;
+            for (int i = 0; i < numRays; i++) {
+                blocked += single[i];
+                mismatches += (single[i] != 0) != batched[i];
+            }
+            core::info("rays up to %.0f units: %d blocked, %d mismatches; single %.2fM rays/sec, batched %.2fM rays/sec\n",
+                maxLength, blocked, mismatches, numRays / singleSecs / 1e6, numRays / batchSecs / 1e6);
+        }
+        getc(stdin);
+    }
+
+    // dynamic blocker benchmark: place and remove building-sized blockers, each update against the full navmesh
+    if (false) {
+        auto world = loadbenchmarkworld();
+
+        const int numBlockers = 32;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < numBlockers; i++) {
+            world->setblocker(i, s2::dynamicblocker{
+                .x = float(core::random::uint32(uint32_t(world->worldsize()))),
+                .y = float(core::random::uint32(uint32_t(world->worldsize()))),
+                .halfwidth = 128.f, .halfheight = 96.f,
+                .angle = float(core::random::uint32(360)) });
+        }
+        double placeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < numBlockers; i++)
+            world->removeblocker(i);
+        double removeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        core::info("%d blockers: place %.3fms, remove %.3fms per blocker\n", numBlockers, placeMs / numBlockers, removeMs / numBlockers);
+        getc(stdin);
+    }
+
+    // multi-goal and bidirectional search benchmark: pathfindany vs. one pathfind per goal, bidirectional vs. flat A*
+    if (false) {
+        auto world = loadbenchmarkworld();
+
+        auto randompoint = [&]() {
+            return vector3f(float(core::random::uint32(uint32_t(world->worldsize()))), float(core::random::uint32(uint32_t(world->worldsize()))), 0.f);
+        };
+        const int numQueries = 32, numGoals = 8;
+        double anyMs = 0.0, repeatedMs = 0.0;
+        for (int i = 0; i < numQueries; i++) {
+            auto from = randompoint();
+            vector<vector3f> goals;
+            for (int g = 0; g < numGoals; g++)
+                goals.push_back(randompoint());
+            auto start = std::chrono::high_resolution_clock::now();
+            world->pathfindany(from, goals);
+            auto mid = std::chrono::high_resolution_clock::now();
+            for (auto& goal : goals)
+                world->pathfind(from, goal);
+            auto end = std::chrono::high_resolution_clock::now();
+            anyMs += std::chrono::duration<double, std::milli>(mid - start).count();
+            repeatedMs += std::chrono::duration<double, std::milli>(end - mid).count();
+        }
+        core::info("%d goals: pathfindany %.3fms, repeated pathfind %.3fms per query\n", numGoals, anyMs / numQueries, repeatedMs / numQueries);
+
+        double flatMs = 0.0, bidirMs = 0.0;
+        for (int i = 0; i < numQueries; i++) {
+            auto from = randompoint(), to = randompoint();
+            auto start = std::chrono::high_resolution_clock::now();
+            world->pathfind(from, to, nullptr, s2::pathmode::flat);
+            auto mid = std::chrono::high_resolution_clock::now();
+            world->pathfind(from, to, nullptr, s2::pathmode::bidirectional);
+            auto end = std::chrono::high_resolution_clock::now();
+            flatMs += std::chrono::duration<double, std::milli>(mid - start).count();
+            bidirMs += std::chrono::duration<double, std::milli>(end - mid).count();
+        }
+        core::info("Single goal: flat %.3fms, bidirectional %.3fms per query\n", flatMs / numQueries, bidirMs / numQueries);
+        getc(stdin);
+    }
+
     resources = nullptr;
     core::info("Finished loading resources.\n");
     //getc(stdin);
@@ -767,6 +1012,8 @@ int main(int argc, char** argv) {
     if (client.connected())
         client.disconnect("bye");
 
+    // The reactor thread waits on sockets, so it has to finish before winsock goes away.
+    network::reactor::Instance().stop();
     network::destroy();
     core::info("Shutting down...\n");
     getc(stdin); 
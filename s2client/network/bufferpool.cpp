@@ -0,0 +1,50 @@
+#include "bufferpool.hpp"
+
+namespace network {
+	void bufferref::release() {
+		if (mBuf && mBuf->mRefs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			if (mBuf->mPool)
+				mBuf->mPool->recycle(mBuf);
+			else
+				delete mBuf;
+		}
+		mBuf = nullptr;
+	}
+
+	bufferpool::~bufferpool() {
+		for (auto& list : mFree) {
+			for (auto* b : list)
+				delete b;
+		}
+	}
+
+	bufferref bufferpool::acquire(size_t minCapacity) {
+		int sizeClass = 0;
+		while (sizeClass < NumClasses && (MinClassSize << sizeClass) < minCapacity)
+			sizeClass++;
+		if (sizeClass == NumClasses)
+			return bufferref(new buffer(minCapacity, nullptr, 0));
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto& list = mFree[sizeClass];
+			if (!list.empty()) {
+				auto* b = list.back();
+				list.pop_back();
+				return bufferref(b);
+			}
+		}
+		return bufferref(new buffer(MinClassSize << sizeClass, this, uint8_t(sizeClass)));
+	}
+
+	void bufferpool::recycle(buffer* b) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			auto& list = mFree[b->mSizeClass];
+			if (list.size() < MaxFreePerClass) {
+				list.push_back(b);
+				return;
+			}
+		}
+		delete b;
+	}
+}
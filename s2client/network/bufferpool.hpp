@@ -0,0 +1,90 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <mutex>
+#include <atomic>
+
+namespace network {
+	class bufferpool;
+
+	// Fixed-capacity byte storage with an intrusive reference count. Contents are uninitialized
+	// when handed out.
+	class buffer {
+		friend class bufferpool;
+		friend class bufferref;
+		std::unique_ptr<uint8_t[]> mBytes;
+		size_t mCapacity;
+		std::atomic<uint32_t> mRefs = 0;
+		// Pool to return to once unreferenced; nullptr for oversized one-off buffers.
+		bufferpool* mPool;
+		uint8_t mSizeClass;
+
+		buffer(size_t capacity, bufferpool* pool, uint8_t sizeClass)
+			: mBytes(new uint8_t[capacity]), mCapacity(capacity), mPool(pool), mSizeClass(sizeClass) {
+		}
+	public:
+		uint8_t* data() { return mBytes.get(); }
+		const uint8_t* data()const { return mBytes.get(); }
+		size_t capacity()const { return mCapacity; }
+	};
+
+	// Shared handle to a pooled buffer; copies add a reference, and the last one to go away
+	// returns the buffer to its pool.
+	class bufferref {
+		buffer* mBuf = nullptr;
+		void release();
+	public:
+		bufferref() = default;
+		explicit bufferref(buffer* b) : mBuf(b) { if (mBuf) mBuf->mRefs++; }
+		bufferref(const bufferref& o) : bufferref(o.mBuf) { }
+		bufferref(bufferref&& o) noexcept : mBuf(o.mBuf) { o.mBuf = nullptr; }
+		~bufferref() { release(); }
+		bufferref& operator=(const bufferref& o) {
+			if (o.mBuf)
+				o.mBuf->mRefs++;
+			release();
+			mBuf = o.mBuf;
+			return *this;
+		}
+		bufferref& operator=(bufferref&& o) noexcept {
+			if (this != &o) {
+				release();
+				mBuf = o.mBuf;
+				o.mBuf = nullptr;
+			}
+			return *this;
+		}
+
+		explicit operator bool()const { return mBuf != nullptr; }
+		buffer* operator->()const { return mBuf; }
+		// Whether another handle references the same buffer, i.e. writes would be visible to it.
+		bool shared()const { return mBuf && mBuf->mRefs.load(std::memory_order_acquire) > 1; }
+	};
+
+	// Free lists of buffers in power-of-two size classes, so steady-state packet traffic reuses
+	// the same few allocations. Thread-safe; buffers may be released on any thread.
+	class bufferpool {
+		friend class bufferref;
+		static constexpr size_t MinClassSize = 64;
+		static constexpr int NumClasses = 11; // 64 B .. 64 KiB
+		static constexpr size_t MaxFreePerClass = 256;
+
+		std::mutex mMutex;
+		array<vector<buffer*>, NumClasses> mFree;
+
+		void recycle(buffer* b);
+	public:
+		bufferpool() = default;
+		~bufferpool();
+		bufferpool(const bufferpool&) = delete;
+		bufferpool& operator=(const bufferpool&) = delete;
+
+		static bufferpool& Instance() {
+			static bufferpool _Instance;
+			return _Instance;
+		}
+
+		// A buffer of at least minCapacity bytes.
+		bufferref acquire(size_t minCapacity);
+	};
+}
@@ -1,20 +1,69 @@
 #include <network/network.hpp>
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 namespace network {
+#ifdef _WIN32
 	namespace _impl {
 		WSADATA wsaData;
 	};
+#endif
 	
 	void init() {
+#ifdef _WIN32
 		WSAStartup(MAKEWORD(2, 2), &_impl::wsaData);
+#endif
+	}
+
+	namespace {
+		SOCKET nonblocking(SOCKET s) {
+			if (s == INVALID_SOCKET)
+				return s;
+#ifdef _WIN32
+			u_long enable = 1;
+			ioctlsocket(s, FIONBIO, &enable);
+#else
+			fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+			fcntl(s, F_SETFD, FD_CLOEXEC);
+#endif
+			return s;
+		}
 	}
 
 	SOCKET udpsocket() {
-		return socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		return nonblocking(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
 	}
 
 	SOCKET tcpsocket() {
-		return socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		return nonblocking(socket(AF_INET, SOCK_STREAM, IPPROTO_TCP));
+	}
+
+	void destroysocket(SOCKET s) {
+		if (s == INVALID_SOCKET)
+			return;
+#ifdef _WIN32
+		closesocket(s);
+#else
+		close(s);
+#endif
+	}
+
+	int lasterror() {
+#ifdef _WIN32
+		return WSAGetLastError();
+#else
+		return errno;
+#endif
+	}
+
+	bool wouldblock(int err) {
+#ifdef _WIN32
+		return err == WSAEWOULDBLOCK || err == WSAEINPROGRESS || err == WSAETIMEDOUT;
+#else
+		return err == EAGAIN || err == EWOULDBLOCK || err == EINPROGRESS || err == EINTR;
+#endif
 	}
 
 	bool resolveaddress(sockaddr_in* result, const char* hostname, int port)
@@ -26,7 +75,7 @@ namespace network {
 		if (0 == getaddrinfo(hostname, "0", &hints, &tmp)) {
 			memset(result, 0, sizeof(sockaddr_in));
 			result->sin_family = AF_INET;
-			result->sin_addr.S_un.S_addr = ((sockaddr_in*)tmp->ai_addr)->sin_addr.S_un.S_addr;
+			result->sin_addr.s_addr = ((sockaddr_in*)tmp->ai_addr)->sin_addr.s_addr;
 			result->sin_port = htons(port);
 			freeaddrinfo(tmp);
 			return true;
@@ -35,15 +84,117 @@ namespace network {
 	}
 
 	bool isreadavailable(SOCKET s, int msTimeout) {
-		fd_set readset = { 1, { s } };
-		timeval timeout = { 0 };
-		timeout.tv_usec = msTimeout * 1000;
-		auto result = select(1, &readset, nullptr, nullptr, &timeout);
+		pollfd fd = { .fd = s, .events = POLLIN, .revents = 0 };
+#ifdef _WIN32
+		auto result = WSAPoll(&fd, 1, msTimeout);
+#else
+		auto result = poll(&fd, 1, msTimeout);
+#endif
 		assert(result != SOCKET_ERROR);
 		return result > 0;
 	}
 
 	void destroy() {
+#ifdef _WIN32
 		WSACleanup();
+#endif
+	}
+
+#ifdef __linux__
+	namespace {
+		uint32_t toepoll(uint32_t events) {
+			return ((events & poller::readable) ? uint32_t(EPOLLIN) : 0u) | ((events & poller::writable) ? uint32_t(EPOLLOUT) : 0u);
+		}
+	}
+
+	poller::poller()
+		: mEpoll(epoll_create1(EPOLL_CLOEXEC)) {
+	}
+	poller::~poller() {
+		if (mEpoll >= 0)
+			close(mEpoll);
+	}
+
+	bool poller::add(SOCKET s, uint32_t events) {
+		epoll_event ev = { .events = toepoll(events), .data = { .fd = s } };
+		return epoll_ctl(mEpoll, EPOLL_CTL_ADD, s, &ev) == 0;
+	}
+	bool poller::modify(SOCKET s, uint32_t events) {
+		epoll_event ev = { .events = toepoll(events), .data = { .fd = s } };
+		return epoll_ctl(mEpoll, EPOLL_CTL_MOD, s, &ev) == 0;
+	}
+	void poller::remove(SOCKET s) {
+		epoll_ctl(mEpoll, EPOLL_CTL_DEL, s, nullptr);
+	}
+
+	int poller::wait(std::span<event> out, int msTimeout) {
+		epoll_event ready[64];
+		int n = epoll_wait(mEpoll, ready, int(min(out.size(), std::size(ready))), msTimeout);
+		for (int i = 0; i < n; i++) {
+			auto e = ready[i].events;
+			out[i] = {
+				.sock = ready[i].data.fd,
+				.events = ((e & EPOLLIN) ? uint32_t(readable) : 0u) | ((e & EPOLLOUT) ? uint32_t(writable) : 0u) | ((e & (EPOLLERR | EPOLLHUP)) ? uint32_t(closed) : 0u)
+			};
+		}
+		return max(n, 0);
+	}
+#else
+	namespace {
+		short topoll(uint32_t events) {
+			return ((events & poller::readable) ? POLLIN : 0) | ((events & poller::writable) ? POLLOUT : 0);
+		}
+	}
+
+	poller::poller() {
+	}
+	poller::~poller() {
+	}
+
+	bool poller::add(SOCKET s, uint32_t events) {
+		mFds.push_back({ .fd = s, .events = topoll(events) });
+		return true;
+	}
+	bool poller::modify(SOCKET s, uint32_t events) {
+		for (auto& fd : mFds) {
+			if (fd.fd == s) {
+				fd.events = topoll(events);
+				return true;
+			}
+		}
+		return false;
+	}
+	void poller::remove(SOCKET s) {
+		std::erase_if(mFds, [=](const pollfd& fd) { return fd.fd == s; });
+	}
+
+	int poller::wait(std::span<event> out, int msTimeout) {
+#ifdef _WIN32
+		int n = mFds.empty() ? 0 : WSAPoll(mFds.data(), ULONG(mFds.size()), msTimeout);
+#else
+		int n = poll(mFds.data(), nfds_t(mFds.size()), msTimeout);
+#endif
+		int count = 0;
+		for (size_t i = 0; i < mFds.size() && n > 0 && count < int(out.size()); i++) {
+			auto e = mFds[i].revents;
+			if (!e)
+				continue;
+			out[count++] = {
+				.sock = mFds[i].fd,
+				.events = ((e & POLLIN) ? uint32_t(readable) : 0u) | ((e & POLLOUT) ? uint32_t(writable) : 0u) | ((e & (POLLERR | POLLHUP)) ? uint32_t(closed) : 0u)
+			};
+		}
+		return count;
+	}
+#endif
+
+	bool poller::waitfor(SOCKET s, uint32_t events, int msTimeout) {
+		event ready[8];
+		int n = wait(ready, msTimeout);
+		for (int i = 0; i < n; i++) {
+			if (ready[i].sock == s && (ready[i].events & (events | closed)))
+				return true;
+		}
+		return false;
 	}
 };
@@ -1,18 +1,80 @@
 #pragma once
 
 #include <core/prerequisites.hpp>
+#include <span>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <cstring>
+#include <poll.h>
+#endif
 
 namespace network {
+#ifndef _WIN32
+	using SOCKET = int;
+	static constexpr SOCKET INVALID_SOCKET = -1;
+	static constexpr int SOCKET_ERROR = -1;
+#endif
 	static const int MAX_PACKET_SIZE = 8192;
 
 	void init();
 
+	// Both are created non-blocking; a call that would block fails and sets wouldblock(lasterror()).
 	SOCKET udpsocket();
 	SOCKET tcpsocket();
+	void destroysocket(SOCKET s);
+
+	// Last socket error of the calling thread, and whether it only means "try again later".
+	int lasterror();
+	bool wouldblock(int err);
 
 	bool resolveaddress(sockaddr_in* result, const char* hostname, int port);
 	
 	bool isreadavailable(SOCKET s, int msTimeout=50);
 
 	void destroy();
+
+	// Waits for readiness on a set of sockets: epoll on Linux, poll/WSAPoll elsewhere. Each
+	// socket is registered once, so a wait is a single call regardless of how often it repeats.
+	class poller {
+	public:
+		enum : uint32_t {
+			readable = 1,
+			writable = 2,
+			// Error or hangup; always reported, never needs to be requested.
+			closed = 4
+		};
+		struct event {
+			SOCKET sock;
+			uint32_t events;
+		};
+	private:
+#ifdef __linux__
+		int mEpoll = -1;
+#else
+		vector<pollfd> mFds;
+#endif
+	public:
+		poller();
+		~poller();
+		poller(const poller&) = delete;
+		poller& operator=(const poller&) = delete;
+
+		bool add(SOCKET s, uint32_t events);
+		bool modify(SOCKET s, uint32_t events);
+		void remove(SOCKET s);
+
+		// Fills out with up to out.size() ready sockets and returns how many there were; 0 on
+		// timeout. msTimeout < 0 waits indefinitely.
+		int wait(std::span<event> out, int msTimeout);
+		// Whether s (which must be registered) has any of events within msTimeout.
+		bool waitfor(SOCKET s, uint32_t events, int msTimeout);
+	};
 }
@@ -2,44 +2,81 @@
 
 namespace network {
 	packet::packet() noexcept
-		: mData(), mReadIdx(0) {
+		: mReadIdx(0) {
 	}
 
 	packet::packet(string&& s) : mReadIdx(0) {
 		write((const uint8_t*)s.data(), s.length());
 	}
 
+	packet::packet(bufferref buf, size_t length) noexcept
+		: mBuf(std::move(buf)), mBegin(0), mEnd(length), mReadIdx(0) {
+		assert(!mBuf || length <= mBuf->capacity());
+	}
+
 	packet::packet(packet&& other) noexcept
-		: mData(std::move(other.mData)), mReadIdx(other.mReadIdx) {
+		: mBuf(std::move(other.mBuf)), mBegin(other.mBegin), mEnd(other.mEnd), mReadIdx(other.mReadIdx) {
+		other.mBegin = other.mEnd = 0;
 	}
 
 	const packet& packet::operator=(packet&& other) noexcept {
-		mData = std::move(other.mData);
+		mBuf = std::move(other.mBuf);
+		mBegin = other.mBegin;
+		mEnd = other.mEnd;
 		mReadIdx = other.mReadIdx;
+		other.mBegin = other.mEnd = 0;
 		return *this;
 	}
 
+	void packet::reserve(size_t length, size_t headroom) {
+		if (mBuf && !mBuf.shared() && mBegin >= headroom && mBegin + length <= mBuf->capacity())
+			return;
+		// Grow geometrically so a run of small writes stays amortized O(1).
+		size_t front = max(headroom, mBuf ? mBegin : DefaultHeadroom);
+		size_t capacity = front + max(length, mBuf ? 2 * (mEnd - mBegin) : size_t(0));
+		auto buf = bufferpool::Instance().acquire(capacity);
+		if (mBuf)
+			memcpy(buf->data() + front, mBuf->data() + mBegin, mEnd - mBegin);
+		mEnd = front + (mEnd - mBegin);
+		mBegin = front;
+		mBuf = std::move(buf);
+	}
+
 	uint8_t* packet::data() {
-		return mData.data();
+		return mBuf ? mBuf->data() + mBegin : nullptr;
 	}
 	uint8_t* packet::nextdata() {
-		return mData.data() + mReadIdx;
+		return data() + mReadIdx;
 	}
 
 	const uint8_t* packet::data() const {
-		return mData.data();
+		return mBuf ? mBuf->data() + mBegin : nullptr;
 	}
 
 	size_t packet::length() const {
-		return mData.size();
+		return mEnd - mBegin;
 	}
 
 	void packet::clear() {
-		mData.clear();
+		mEnd = mBegin;
 	}
 
 	void packet::resize(size_t length) {
-		mData.resize(length);
+		reserve(length);
+		mEnd = mBegin + length;
+	}
+
+	packet packet::slice(size_t offset, size_t length) const {
+		assert(offset + length <= this->length());
+		packet p;
+		p.mBuf = mBuf;
+		p.mBegin = mBegin + offset;
+		p.mEnd = p.mBegin + length;
+		return p;
+	}
+
+	packetview packet::view() const {
+		return packetview(std::span<const uint8_t>(data(), length()), mReadIdx);
 	}
 
 	size_t packet::tell()const {
@@ -62,10 +99,10 @@ namespace network {
 	}
 
 	bool packet::read(uint8_t* data, size_t length) {
-		assert((mReadIdx + length) <= mData.size());
-		if ((mReadIdx + length) > mData.size())
+		assert((mReadIdx + length) <= this->length());
+		if ((mReadIdx + length) > this->length())
 			return false;
-		memcpy(data, mData.data() + mReadIdx, length);
+		memcpy(data, this->data() + mReadIdx, length);
 		mReadIdx += length;
 		return true;
 	}
@@ -98,7 +135,14 @@ namespace network {
 	}
 
 	void packet::write(const uint8_t* data, size_t length) {
-		mData.insert(mData.end(), data, data + length);
+		reserve(this->length() + length);
+		memcpy(mBuf->data() + mEnd, data, length);
+		mEnd += length;
+	}
+	void packet::prepend(const uint8_t* data, size_t length) {
+		reserve(this->length(), length);
+		mBegin -= length;
+		memcpy(mBuf->data() + mBegin, data, length);
 	}
 	void packet::writebyte(uint8_t b) {
 		return write<uint8_t>(b);
@@ -1,28 +1,107 @@
 #pragma once
 
 #include <core/prerequisites.hpp>
+#include <network/bufferpool.hpp>
+#include <span>
+#include <cstring>
 
 namespace network {
+	// Non-owning read cursor over bytes someone else keeps alive, e.g. a packet's. Same read
+	// interface as packet.
+	class packetview {
+	private:
+		std::span<const uint8_t> mData;
+		size_t mReadIdx = 0;
+	public:
+		packetview() = default;
+		packetview(std::span<const uint8_t> data, size_t readIdx = 0)
+			: mData(data), mReadIdx(readIdx) {
+		}
+
+		const uint8_t* data()const { return mData.data(); }
+		const uint8_t* nextdata()const { return mData.data() + mReadIdx; }
+		size_t length()const { return mData.size(); }
+
+		size_t tell()const { return mReadIdx; }
+		void seek(size_t idx) { mReadIdx = min(length(), idx); }
+		void advance(int64_t offs) {
+			mReadIdx += offs;
+			assert(mReadIdx <= length());
+		}
+		size_t remaining()const { return length() - mReadIdx; }
+		bool end()const { return mReadIdx >= length(); }
+		bool read(uint8_t* data, size_t length) {
+			assert((mReadIdx + length) <= mData.size());
+			if ((mReadIdx + length) > mData.size())
+				return false;
+			memcpy(data, mData.data() + mReadIdx, length);
+			mReadIdx += length;
+			return true;
+		}
+
+		template<typename T>
+		T read() {
+			T out;
+			if (!read(reinterpret_cast<uint8_t*>(&out), sizeof(T)))
+				assert(false);
+			return out;
+		}
+		uint8_t  readbyte() { return read<uint8_t>(); }
+		uint16_t readword() { return read<uint16_t>(); }
+		uint32_t readdword() { return read<uint32_t>(); }
+		uint64_t readqword() { return read<uint64_t>(); }
+		float    readsingle() { return read<float>(); }
+		string   readstring() {
+			auto rest = mData.subspan(mReadIdx);
+			auto nul = std::find(rest.begin(), rest.end(), uint8_t(0));
+			string str(rest.begin(), nul);
+			mReadIdx += str.length() + (nul != rest.end() ? 1 : 0);
+			return str;
+		}
+	};
+
+	// Byte buffer with a read cursor, backed by a pooled, refcounted buffer. Writing packets keep
+	// DefaultHeadroom bytes free in front so headers can be prepended without moving the body,
+	// and slice() shares the storage instead of copying it.
 	class packet {
 	private:
-		vector<uint8_t> mData;
+		bufferref mBuf;
+		// Contents are mBuf[mBegin, mEnd); mReadIdx is relative to mBegin.
+		size_t mBegin = 0;
+		size_t mEnd = 0;
 		size_t mReadIdx;
+
+		// Makes the buffer exclusively ours with room for length bytes after mBegin and at least
+		// headroom bytes before it, copying the contents over if it has to move.
+		void reserve(size_t length, size_t headroom = 0);
 	public:
+		// Enough for a netclient frame header and command byte.
+		static constexpr size_t DefaultHeadroom = 16;
+
 		packet() noexcept;
 		packet(string&& s);
+		// Takes over the first length bytes of buf.
+		packet(bufferref buf, size_t length) noexcept;
 		packet(const packet& o) = delete;
 		packet(packet&& other) noexcept;
 
 		const packet& operator=(const packet& other) = delete;
 		const packet& operator=(packet&& other) noexcept;
 
+		// Writable as long as no slice shares the buffer.
 		uint8_t* data();
 		uint8_t* nextdata();
 		const uint8_t* data()const;
 		size_t length()const;
 		void clear();
+		// New bytes are uninitialized.
 		void resize(size_t length);
 
+		// length bytes from offset, sharing this packet's buffer; the read cursor starts at 0.
+		packet slice(size_t offset, size_t length)const;
+		// Read cursor over the contents, starting where this packet's cursor is.
+		packetview view()const;
+
 		size_t tell()const;
 		void seek(size_t idx);
 		void advance(int64_t offs);
@@ -34,7 +113,7 @@ namespace network {
 		T read() {
 			T out;
 			if (!read(reinterpret_cast<uint8_t*>(&out), sizeof(T)))
-				assert(FALSE);
+				assert(false);
 			return out;
 		}
 		uint8_t  readbyte();
@@ -45,6 +124,8 @@ namespace network {
 		string   readstring();
 
 		void write(const uint8_t* data, size_t length);
+		// Inserts data in front of the contents, into the headroom when there is enough.
+		void prepend(const uint8_t* data, size_t length);
 
 		template<typename T>
 		void write(const T& data) {
@@ -0,0 +1,110 @@
+#include "reactor.hpp"
+
+#include <core/io/logger.hpp>
+
+namespace network {
+	reactor::reactor()
+		: mEpoch(std::chrono::steady_clock::now()) {
+		mWakeSock = network::udpsocket();
+		memset(&mWakeAddr, 0, sizeof(mWakeAddr));
+		mWakeAddr.sin_family = AF_INET;
+		mWakeAddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		socklen_t len = sizeof(mWakeAddr);
+		if (bind(mWakeSock, (const sockaddr*)&mWakeAddr, sizeof(mWakeAddr)) == SOCKET_ERROR || getsockname(mWakeSock, (sockaddr*)&mWakeAddr, &len) == SOCKET_ERROR)
+			core::error("reactor: failed to bind wakeup socket, error %d\n", network::lasterror());
+		mPoller.add(mWakeSock, poller::readable);
+		mThread = std::thread([this] { run(); });
+	}
+
+	reactor::~reactor() {
+		stop();
+	}
+
+	void reactor::stop() {
+		if (!mThread.joinable())
+			return;
+		mStopping = true;
+		wake();
+		mThread.join();
+		network::destroysocket(mWakeSock);
+		mWakeSock = INVALID_SOCKET;
+	}
+
+	uint64_t reactor::now() const {
+		return uint64_t(std::chrono::duration_cast<milliseconds>(std::chrono::steady_clock::now() - mEpoch).count());
+	}
+
+	void reactor::wake() {
+		char b = 0;
+		sendto(mWakeSock, &b, 1, 0, (const sockaddr*)&mWakeAddr, sizeof(mWakeAddr));
+	}
+
+	void reactor::attach(SOCKET s, handler onreadable) {
+		{
+			std::lock_guard<std::recursive_mutex> lock(mMutex);
+			mHandlers[s] = std::move(onreadable);
+			mPending.push_back({ s, true });
+		}
+		wake();
+	}
+
+	void reactor::detach(SOCKET s) {
+		{
+			// Handlers run under the lock, so once it is ours none is in flight.
+			std::lock_guard<std::recursive_mutex> lock(mMutex);
+			mHandlers.erase(s);
+			mPending.push_back({ s, false });
+		}
+		wake();
+	}
+
+	reactor::timerid reactor::schedule(milliseconds delay, handler fn, milliseconds period) {
+		timerid id;
+		{
+			std::lock_guard<std::recursive_mutex> lock(mMutex);
+			id = mTimers.schedule(now(), uint64_t(delay.count()), std::move(fn), uint64_t(period.count()));
+		}
+		wake();
+		return id;
+	}
+
+	void reactor::cancel(timerid id) {
+		std::lock_guard<std::recursive_mutex> lock(mMutex);
+		mTimers.cancel(id);
+	}
+
+	void reactor::run() {
+		vector<std::function<void()>> due;
+		poller::event ready[64];
+		int timeout = -1;
+		while (!mStopping) {
+			int n = mPoller.wait(ready, timeout);
+
+			std::lock_guard<std::recursive_mutex> lock(mMutex);
+			for (int i = 0; i < n; i++) {
+				if (ready[i].sock == mWakeSock) {
+					char buf[64];
+					while (recv(mWakeSock, buf, sizeof(buf), 0) > 0);
+					continue;
+				}
+				auto it = mHandlers.find(ready[i].sock);
+				if (it != mHandlers.end())
+					it->second();
+			}
+
+			mTimers.advance(now(), due);
+			for (auto& fn : due)
+				fn();
+			due.clear();
+
+			for (auto& [s, add] : mPending) {
+				if (add)
+					mPoller.add(s, poller::readable);
+				else
+					mPoller.remove(s);
+			}
+			mPending.clear();
+			timeout = int(mTimers.nextdue());
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <core/utils/timerwheel.hpp>
+#include <network/network.hpp>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+namespace network {
+	// One thread that waits on every attached socket and runs timers off a timer wheel, so any
+	// number of clients cost a single blocking wait instead of a poll loop each. Handlers and
+	// timer callbacks run on the reactor thread one at a time and must not block.
+	class reactor {
+	public:
+		using handler = std::function<void()>;
+		using timerid = core::timerwheel::timerid;
+	private:
+		poller mPoller;
+		// Loopback datagram socket the reactor sends to itself to interrupt a wait.
+		SOCKET mWakeSock = INVALID_SOCKET;
+		sockaddr_in mWakeAddr;
+		// Held while handlers and timers run, so timer callbacks may schedule and cancel.
+		std::recursive_mutex mMutex;
+		unordered_map<SOCKET, handler> mHandlers;
+		// Registrations made since the last wait (true to add), applied by the reactor thread so
+		// the poller is only ever touched from there.
+		vector<std::pair<SOCKET, bool>> mPending;
+		core::timerwheel mTimers;
+		std::chrono::steady_clock::time_point mEpoch;
+		std::atomic<bool> mStopping = false;
+		std::thread mThread;
+
+		uint64_t now()const;
+		void wake();
+		void run();
+	public:
+		reactor();
+		~reactor();
+		reactor(const reactor&) = delete;
+		reactor& operator=(const reactor&) = delete;
+
+		static reactor& Instance() {
+			static reactor _Instance;
+			return _Instance;
+		}
+
+		// Calls onreadable on the reactor thread whenever s has data; the handler should read
+		// until the socket would block.
+		void attach(SOCKET s, handler onreadable);
+		// Once this returns the handler for s is not running and won't be called again. Must not
+		// be called from s's own handler.
+		void detach(SOCKET s);
+
+		// Runs fn on the reactor thread after delay, then every period if it is nonzero.
+		timerid schedule(milliseconds delay, handler fn, milliseconds period = milliseconds(0));
+		void cancel(timerid id);
+
+		// Joins the reactor thread and closes the wakeup socket; call it before network::destroy().
+		// Nothing runs afterwards, so attaching or scheduling then is a no-op. Safe to call again.
+		void stop();
+	};
+}
@@ -1,63 +1,111 @@
 #include "tcpclient.hpp"
 #include <network/network.hpp>
 
+#include <core/io/logger.hpp>
+
 namespace network {
 	tcpclient::tcpclient()
 		: mConnected(false) {
-		mServer = { 0 };
-		mSock = network::tcpsocket();
+		mServer = {};
+		opensocket();
 	}
 
 	tcpclient::~tcpclient() {
-		closesocket(mSock);
+		network::destroysocket(mSock);
+	}
+
+	void tcpclient::opensocket() {
+		mSock = network::tcpsocket();
+		mPoller.add(mSock, poller::readable);
 	}
 
 	bool tcpclient::connect(const char* hostname, int port) {
 		if(!network::resolveaddress(&mServer, hostname, port))
 			return false;
 		mConnected = SOCKET_ERROR != ::connect(mSock, (sockaddr*)&mServer, sizeof(mServer));
-		if (!mConnected) {
-			auto err = WSAGetLastError();
-			OutputDebugStringA(("Winsock error: " + std::to_string(err)).c_str());
+		if (!mConnected && network::wouldblock(network::lasterror())) {
+			// Non-blocking connect: done once the socket turns writable, with SO_ERROR saying how.
+			mPoller.modify(mSock, poller::writable);
+			if (mPoller.waitfor(mSock, poller::writable, ConnectTimeoutMs)) {
+				int err = 0;
+				socklen_t len = sizeof(err);
+				getsockopt(mSock, SOL_SOCKET, SO_ERROR, (char*)&err, &len);
+				mConnected = err == 0;
+			}
+			mPoller.modify(mSock, poller::readable);
 		}
+		if (!mConnected)
+			core::warning("connect() to %s:%d failed, socket error %d\n", hostname, port, network::lasterror());
 		return mConnected;
 	}
 
 	void tcpclient::disconnect() {
-		closesocket(mSock);
-		mSock = network::tcpsocket();
+		mPoller.remove(mSock);
+		network::destroysocket(mSock);
+		mConnected = false;
+		opensocket();
 	}
 
 	bool tcpclient::connected() const {
 		return mConnected;
 	}
 	bool tcpclient::isreadpending() const {
-		return network::isreadavailable(mSock);
+		return const_cast<poller&>(mPoller).waitfor(mSock, poller::readable, 50);
 	}
 
 	int tcpclient::send(const packet& p) const {
-		return ::send(mSock, reinterpret_cast<const char*>(p.data()), static_cast<int>(p.length()), 0);
+		auto& poll = const_cast<poller&>(mPoller);
+		const char* data = reinterpret_cast<const char*>(p.data());
+		int total = static_cast<int>(p.length()), sent = 0;
+#ifdef MSG_NOSIGNAL
+		const int flags = MSG_NOSIGNAL;
+#else
+		const int flags = 0;
+#endif
+		while (sent < total) {
+			int nbytes = ::send(mSock, data + sent, total - sent, flags);
+			if (nbytes > 0) {
+				sent += nbytes;
+				continue;
+			}
+			if (!network::wouldblock(network::lasterror()))
+				return sent > 0 ? sent : SOCKET_ERROR;
+			poll.modify(mSock, poller::writable);
+			bool ready = poll.waitfor(mSock, poller::writable, IoTimeoutMs);
+			poll.modify(mSock, poller::readable);
+			if (!ready)
+				break;
+		}
+		return sent;
 	}
-	int tcpclient::recv(packet* out) const {
+
+	template<typename Buffer>
+	int tcpclient::recvall(Buffer* out) const {
+		auto& poll = const_cast<poller&>(mPoller);
 		out->clear();
 		out->resize(network::MAX_PACKET_SIZE);
-		int nbytes = 0, totalbytes = 0;
-		do {
-			nbytes = ::recv(mSock, reinterpret_cast<char*>(out->data() + totalbytes), static_cast<int>(out->length() - totalbytes), 0);
-			totalbytes += nbytes;
-		} while (nbytes != 0);
+		size_t totalbytes = 0;
+		for (;;) {
+			if (totalbytes == out->length())
+				out->resize(out->length() * 2);
+			int nbytes = ::recv(mSock, reinterpret_cast<char*>(out->data() + totalbytes), static_cast<int>(out->length() - totalbytes), 0);
+			if (nbytes > 0) {
+				totalbytes += nbytes;
+				continue;
+			}
+			if (nbytes == 0 || !network::wouldblock(network::lasterror()))
+				break;
+			if (!poll.waitfor(mSock, poller::readable, IoTimeoutMs))
+				break;
+		}
 		out->resize(totalbytes);
-		return totalbytes;
+		return static_cast<int>(totalbytes);
+	}
+
+	int tcpclient::recv(packet* out) const {
+		return recvall(out);
 	}
 	int tcpclient::recvstring(string* out) const {
-		out->clear();
-		out->resize(network::MAX_PACKET_SIZE);
-		int nbytes = 0, totalbytes = 0;
-		do {
-			nbytes = ::recv(mSock, reinterpret_cast<char*>(out->data() + totalbytes), static_cast<int>(out->length() - totalbytes), 0);
-			totalbytes += nbytes;
-		} while (nbytes != 0);
-		out->resize(totalbytes);
-		return totalbytes;
+		return recvall(out);
 	}
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <core/prerequisites.hpp>
+#include <network/network.hpp>
 #include <network/packet.hpp>
 
 namespace network {
@@ -9,6 +10,16 @@ namespace network {
 		SOCKET mSock;
 		bool mConnected;
 		sockaddr_in mServer;
+		poller mPoller;
+
+		// The socket is non-blocking; these bound how long the blocking-style calls below wait.
+		static constexpr int ConnectTimeoutMs = 5000;
+		static constexpr int IoTimeoutMs = 5000;
+
+		void opensocket();
+		// Reads until the peer closes the connection, growing out as needed.
+		template<typename Buffer>
+		int recvall(Buffer* out)const;
 	public:
 		tcpclient();
 		~tcpclient();
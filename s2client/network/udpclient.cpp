@@ -7,37 +7,184 @@
 namespace network {
 	udpclient::udpclient(const char* hostname, int port) {
 		mSock = network::udpsocket();
-		int timeout = 50;
-		setsockopt(mSock, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+		int rcvbuf = RecvBufferSize;
+		setsockopt(mSock, SOL_SOCKET, SO_RCVBUF, (const char*)&rcvbuf, sizeof(rcvbuf));
+		mPoller.add(mSock, poller::readable);
 		network::resolveaddress(&mServer, hostname, port);
 	}
 	udpclient::~udpclient() {
-		closesocket(mSock);
+		if (mReactor)
+			mReactor->detach(mSock);
+		network::destroysocket(mSock);
+	}
+
+	void udpclient::attach(reactor& r) {
+		mReactor = &r;
+		mPoller.remove(mSock);
+		r.attach(mSock, [this] {
+			bool received = false;
+			for (int n; (n = readbatch()) > 0; received = true) {
+				std::lock_guard<std::mutex> lock(mInboxMutex);
+				for (int i = 0; i < n; i++)
+					mInbox.emplace_back(std::move(mRecvBufs[i]), size_t(mRecvLengths[i]));
+			}
+			if (received)
+				mInboxCv.notify_all();
+		});
+	}
+
+	void udpclient::wake() {
+		{
+			std::lock_guard<std::mutex> lock(mInboxMutex);
+			mWoken = true;
+		}
+		mInboxCv.notify_all();
 	}
 
 	bool udpclient::isreadpending(int msTimeout) const {
-		return network::isreadavailable(mSock, msTimeout);
+		if (!mReactor)
+			return const_cast<poller&>(mPoller).waitfor(mSock, poller::readable, msTimeout);
+		std::unique_lock<std::mutex> lock(mInboxMutex);
+		mInboxCv.wait_for(lock, milliseconds(msTimeout), [this] { return mWoken || !mInbox.empty(); });
+		mWoken = false;
+		return !mInbox.empty();
 	}
 
 	int udpclient::send(const packet& p)const {
 		int r = sendto(mSock, (const char*)p.data(), static_cast<int>(p.length()), 0, (const sockaddr*)&mServer, sizeof(mServer));
 		if (r == SOCKET_ERROR) {
-			core::error("sendto() failed %X", WSAGetLastError());
+			auto err = network::lasterror();
+			if (network::wouldblock(err))
+				return 0;
+			core::warning("sendto() socket error %d (%Xh)\n", err, err);
 		}
 		return r;
 	}
+	void udpclient::queue(packet&& p) {
+		mOutbox.push_back(std::move(p));
+	}
+
+	int udpclient::flush() {
+		int sent = 0;
+#ifdef __linux__
+		mmsghdr msgs[SendBatch];
+		iovec iov[SendBatch];
+		while (!mOutbox.empty()) {
+			int n = min(int(mOutbox.size()), SendBatch);
+			for (int i = 0; i < n; i++) {
+				iov[i] = { .iov_base = mOutbox[i].data(), .iov_len = mOutbox[i].length() };
+				msgs[i] = {};
+				msgs[i].msg_hdr.msg_name = &mServer;
+				msgs[i].msg_hdr.msg_namelen = sizeof(mServer);
+				msgs[i].msg_hdr.msg_iov = &iov[i];
+				msgs[i].msg_hdr.msg_iovlen = 1;
+			}
+			int r = sendmmsg(mSock, msgs, unsigned(n), 0);
+			if (r <= 0) {
+				auto err = network::lasterror();
+				// Full send buffer: keep the rest for the next flush.
+				if (network::wouldblock(err))
+					break;
+				core::warning("sendmmsg() socket error %d (%Xh)\n", err, err);
+				return SOCKET_ERROR;
+			}
+			mSendCalls++;
+			mSendDatagrams += r;
+			mOutbox.erase(mOutbox.begin(), mOutbox.begin() + r);
+			sent += r;
+		}
+#else
+		while (!mOutbox.empty()) {
+			int r = send(mOutbox.front());
+			if (r == SOCKET_ERROR)
+				return SOCKET_ERROR;
+			if (r == 0)
+				break;
+			mSendCalls++;
+			mSendDatagrams++;
+			mOutbox.pop_front();
+			sent++;
+		}
+#endif
+		return sent;
+	}
+
+	iostats udpclient::stats() const {
+		return iostats{
+			.recvCalls = mRecvCalls,
+			.recvDatagrams = mRecvDatagrams,
+			.sendCalls = mSendCalls,
+			.sendDatagrams = mSendDatagrams
+		};
+	}
+
+	int udpclient::readbatch() {
+		int n = 0;
+		for (auto& buf : mRecvBufs) {
+			if (!buf)
+				buf = bufferpool::Instance().acquire(network::MAX_PACKET_SIZE);
+		}
+#ifdef __linux__
+		mmsghdr msgs[RecvBatch];
+		iovec iov[RecvBatch];
+		for (int i = 0; i < RecvBatch; i++) {
+			iov[i] = { .iov_base = mRecvBufs[i]->data(), .iov_len = size_t(network::MAX_PACKET_SIZE) };
+			msgs[i] = {};
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		n = recvmmsg(mSock, msgs, RecvBatch, MSG_DONTWAIT, nullptr);
+		if (n < 0) {
+			auto err = network::lasterror();
+			if (!network::wouldblock(err))
+				core::warning("recvmmsg() socket error %d (%Xh)\n", err, err);
+			return -1;
+		}
+		for (int i = 0; i < n; i++)
+			mRecvLengths[i] = int(msgs[i].msg_len);
+		mRecvCalls++;
+#else
+		// No batched receive here, but datagrams still land straight in pooled buffers.
+		for (; n < RecvBatch; n++) {
+			int nbytes = ::recv(mSock, (char*)mRecvBufs[n]->data(), network::MAX_PACKET_SIZE, 0);
+			if (nbytes == SOCKET_ERROR) {
+				auto err = network::lasterror();
+				if (!network::wouldblock(err))
+					core::warning("recv() socket error %d (%Xh)\n", err, err);
+				break;
+			}
+			mRecvLengths[n] = nbytes;
+		}
+		mRecvCalls += n;
+		if (n == 0)
+			return -1;
+#endif
+		mRecvDatagrams += n;
+		return n;
+	}
+
 	int udpclient::recv(packet* out) const {
+		if (!mReactor)
+			return readdatagram(out);
+		std::lock_guard<std::mutex> lock(mInboxMutex);
+		if (mInbox.empty())
+			return -1;
+		*out = std::move(mInbox.front());
+		mInbox.pop_front();
+		return static_cast<int>(out->length());
+	}
+	int udpclient::readdatagram(packet* out) const {
 		sockaddr_in from;
-		int fromlen = sizeof(sockaddr_in);
+		socklen_t fromlen = sizeof(sockaddr_in);
 
 		out->clear();
 		out->resize(network::MAX_PACKET_SIZE);
 		int nbytes = recvfrom(mSock, (char*)out->data(), static_cast<int>(out->length()), 0, (sockaddr*)&from, &fromlen);
 		if (nbytes == SOCKET_ERROR) {
-			auto err = WSAGetLastError();
-			if (err == WSAETIMEDOUT)
+			auto err = network::lasterror();
+			if (network::wouldblock(err))
 				return -1;
-			core::warning("recvfrom() winsock error %d (%Xh)\n", err, err);
+			core::warning("recvfrom() socket error %d (%Xh)\n", err, err);
 			return -1;
 		}
 		else {
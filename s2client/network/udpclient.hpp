@@ -1,19 +1,77 @@
 #pragma once
 
 #include <core/prerequisites.hpp>
+#include <network/network.hpp>
 #include <network/packet.hpp>
+#include <network/reactor.hpp>
+#include <condition_variable>
 
 namespace network {
+	// Syscall and datagram counts of a udpclient's batched paths.
+	struct iostats {
+		uint64_t recvCalls = 0;
+		uint64_t recvDatagrams = 0;
+		uint64_t sendCalls = 0;
+		uint64_t sendDatagrams = 0;
+
+		double avgrecvbatch()const { return recvCalls ? double(recvDatagrams) / recvCalls : 0.0; }
+		double avgsendbatch()const { return sendCalls ? double(sendDatagrams) / sendCalls : 0.0; }
+	};
+
 	class udpclient {
 	private:
+		// Datagrams per recvmmsg/sendmmsg call.
+		static constexpr int RecvBatch = 32;
+		static constexpr int SendBatch = 64;
+		// Room for a snapshot burst to queue up between two reactor wakeups.
+		static constexpr int RecvBufferSize = 1 << 20;
+
 		SOCKET mSock;
+		poller mPoller;
+		// Set once attached; from then on the reactor reads the socket into mInbox.
+		reactor* mReactor = nullptr;
+		mutable std::mutex mInboxMutex;
+		mutable std::condition_variable mInboxCv;
+		mutable deque<packet> mInbox;
+		mutable bool mWoken = false;
+
+		// Pooled MAX_PACKET_SIZE buffers that batched receives land in directly; each filled one
+		// becomes a packet as is and its slot gets a fresh buffer. Only touched by whichever
+		// thread drains the socket (the reactor's once attached).
+		array<bufferref, RecvBatch> mRecvBufs;
+		array<int, RecvBatch> mRecvLengths;
+		// Frames waiting for the next flush().
+		deque<packet> mOutbox;
+		// Atomic so stats() can be read from any thread.
+		std::atomic<uint64_t> mRecvCalls = 0, mRecvDatagrams = 0;
+		std::atomic<uint64_t> mSendCalls = 0, mSendDatagrams = 0;
+
+		int readdatagram(packet* out)const;
+		// Reads up to RecvBatch datagrams into mRecvBufs with one call; returns how many, or -1
+		// once the socket would block.
+		int readbatch();
 	public:
 		udpclient(const char* hostname, int port);
 		~udpclient();
 
+		// Hands the socket to r, which queues incoming datagrams as they arrive; isreadpending
+		// then waits on that queue instead of polling the socket.
+		void attach(reactor& r);
+		// Makes a waiting or the next isreadpending() return early, e.g. when a timer fires.
+		void wake();
+
 		bool isreadpending(int msTimeout=50)const;
 
+		// Bytes sent, 0 if the send buffer is full, or SOCKET_ERROR if the socket failed.
 		int send(const packet& p)const;
+		// Queues p for the next flush(), which sends everything queued with as few calls as the
+		// platform allows. Neither is thread-safe.
+		void queue(packet&& p);
+		// Returns the number of datagrams sent, or SOCKET_ERROR if the socket failed. Frames that
+		// didn't go out stay queued.
+		int flush();
+		iostats stats()const;
+		// Reads one datagram without blocking; -1 if none is queued.
 		int recv(packet* out)const;
 
 	private:
@@ -0,0 +1,201 @@
+#include "flowfield.hpp"
+
+#include <s2/navmesh2d.hpp>
+#include <core/io/logger.hpp>
+#include <core/utils/threadpool.hpp>
+
+namespace s2 {
+	namespace {
+		constexpr int TileSize = 32;
+		// Links span at most two cells, so only this band along a tile's edge has links leaving it.
+		constexpr int LinkReach = 2;
+		constexpr float Unreached = std::numeric_limits<float>::infinity();
+		// Width of the cost band settled per round, in tile widths.
+		constexpr float BandTiles = 2.f;
+
+		struct fieldentry {
+			float cost;
+			int n;
+			constexpr bool operator>(const fieldentry& o)const { return cost > o.cost; }
+		};
+		struct fieldtile {
+			int x0, y0, x1, y1;
+			vector<std::pair<int, float>> seeds;
+			float minseed = std::numeric_limits<float>::infinity();
+			bool changed = false;
+		};
+	}
+
+	std::shared_ptr<flowfield> flowfield::Build(const navmesh2d& navmesh, int goal, std::span<const uint32_t> reverseOffsets, std::span<const incominglink> reverseLinks) {
+		auto start = high_resolution_clock::now();
+		auto field = std::shared_ptr<flowfield>(new flowfield());
+		int w = navmesh.width(), h = navmesh.height();
+		field->mGoal = goal;
+		field->mWidth = w;
+		field->mHeight = h;
+		field->mCellWidth = navmesh.cellwidth();
+		field->mCellHeight = navmesh.cellheight();
+		field->mCost.assign(size_t(w) * h, Unreached);
+		field->mNext.assign(size_t(w) * h, -1);
+		auto& cost = field->mCost;
+
+		int tilesx = (w + TileSize - 1) / TileSize;
+		int tilesy = (h + TileSize - 1) / TileSize;
+		vector<fieldtile> tiles(size_t(tilesx) * tilesy);
+		for (int ty = 0; ty < tilesy; ty++) {
+			for (int tx = 0; tx < tilesx; tx++) {
+				auto& t = tiles[size_t(ty) * tilesx + tx];
+				t.x0 = tx * TileSize;
+				t.y0 = ty * TileSize;
+				t.x1 = min(w, t.x0 + TileSize);
+				t.y1 = min(h, t.y0 + TileSize);
+			}
+		}
+		auto tileof = [&](int n) { return (n / w / TileSize) * tilesx + (n % w / TileSize); };
+
+		// Tiled label-correcting search. Each round settles the pending tiles whose cheapest seed lies
+		// within one cost band of the cheapest overall, with a Dijkstra confined to the tile that walks
+		// incoming links; each tile only writes its own cells. Tiles around the ones that changed then
+		// pull improved costs across their borders, which only reads, and become pending. Holding back
+		// far-away tiles keeps them from being settled with costs that are bound to improve.
+		auto& pool = core::threadpool::Instance();
+		const float band = BandTiles * TileSize * max(field->mCellWidth, field->mCellHeight);
+		tiles[tileof(goal)].seeds.push_back({ goal, 0.f });
+		tiles[tileof(goal)].minseed = 0.f;
+		vector<int> pending{ tileof(goal) };
+		vector<char> ispending(tiles.size());
+		ispending[tileof(goal)] = 1;
+		vector<int> active;
+		vector<char> candidate(tiles.size());
+		int rounds = 0;
+		while (!pending.empty()) {
+			rounds++;
+			float lowest = Unreached;
+			for (int ti : pending)
+				lowest = min(lowest, tiles[ti].minseed);
+			active.clear();
+			size_t kept = 0;
+			for (int ti : pending) {
+				if (tiles[ti].minseed <= lowest + band) {
+					active.push_back(ti);
+					ispending[ti] = 0;
+				}
+				else {
+					pending[kept++] = ti;
+				}
+			}
+			pending.resize(kept);
+
+			pool.parallel_for(int(active.size()), [&](int i, int) {
+				auto& t = tiles[active[i]];
+				min_heap<fieldentry> open;
+				for (auto& [n, c] : t.seeds) {
+					if (c < cost[n]) {
+						cost[n] = c;
+						open.push(fieldentry{ .cost = c, .n = n });
+					}
+				}
+				t.seeds.clear();
+				t.minseed = Unreached;
+				t.changed = !open.empty();
+				while (!open.empty()) {
+					auto e = open.top();
+					open.pop();
+					if (e.cost > cost[e.n])
+						continue;
+					for (uint32_t l = reverseOffsets[e.n]; l < reverseOffsets[e.n + 1]; l++) {
+						int u = reverseLinks[l].from;
+						int ux = u % w, uy = u / w;
+						if (ux < t.x0 || ux >= t.x1 || uy < t.y0 || uy >= t.y1)
+							continue;
+						float c = e.cost + reverseLinks[l].cost;
+						if (c < cost[u]) {
+							cost[u] = c;
+							open.push(fieldentry{ .cost = c, .n = u });
+						}
+					}
+				}
+			});
+
+			vector<int> neighbours;
+			std::fill(candidate.begin(), candidate.end(), 0);
+			for (int ti : active) {
+				if (!tiles[ti].changed)
+					continue;
+				int tx = ti % tilesx, ty = ti / tilesx;
+				for (int ny = max(0, ty - 1); ny <= min(tilesy - 1, ty + 1); ny++) {
+					for (int nx = max(0, tx - 1); nx <= min(tilesx - 1, tx + 1); nx++) {
+						int ni = ny * tilesx + nx;
+						if (ni != ti && !candidate[ni]) {
+							candidate[ni] = 1;
+							neighbours.push_back(ni);
+						}
+					}
+				}
+			}
+			pool.parallel_for(int(neighbours.size()), [&](int i, int) {
+				auto& t = tiles[neighbours[i]];
+				for (int y = t.y0; y < t.y1; y++) {
+					bool edgerow = y < t.y0 + LinkReach || y >= t.y1 - LinkReach;
+					for (int x = t.x0; x < t.x1; x++) {
+						if (!edgerow && x == t.x0 + LinkReach)
+							x = max(x, t.x1 - LinkReach);
+						int u = y * w + x;
+						float best = cost[u];
+						for (auto& link : navmesh.links(navmesh.get(u))) {
+							int vx = link.to % w, vy = link.to / w;
+							if (vx >= t.x0 && vx < t.x1 && vy >= t.y0 && vy < t.y1)
+								continue;
+							best = min(best, link.cost + cost[link.to]);
+						}
+						if (best < cost[u]) {
+							t.seeds.push_back({ u, best });
+							t.minseed = min(t.minseed, best);
+						}
+					}
+				}
+			});
+			for (int ni : neighbours) {
+				if (!tiles[ni].seeds.empty() && !ispending[ni]) {
+					ispending[ni] = 1;
+					pending.push_back(ni);
+				}
+			}
+		}
+
+		// Every reachable cell points at the neighbour its cost came through.
+		pool.parallel_for(h, [&](int y, int) {
+			for (int x = 0; x < w; x++) {
+				int u = y * w + x;
+				if (u == goal || cost[u] == Unreached)
+					continue;
+				float best = Unreached;
+				for (auto& link : navmesh.links(navmesh.get(u))) {
+					float c = link.cost + cost[link.to];
+					if (c < best) {
+						best = c;
+						field->mNext[u] = link.to;
+					}
+				}
+			}
+		});
+
+		double elapsed = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+		core::info("Built flow field to node %d: %d tiles, %d rounds in %.2fms\n", goal, int(tiles.size()), rounds, elapsed);
+		return field;
+	}
+
+	bool flowfield::waypoint(float wx, float wy, int lookahead, float& outx, float& outy) const {
+		int x = int(wx / mCellWidth), y = int(wy / mCellHeight);
+		if (x < 0 || y < 0 || x >= mWidth || y >= mHeight)
+			return false;
+		int n = y * mWidth + x;
+		if (!reachable(n))
+			return false;
+		for (int i = 0; i < lookahead && mNext[n] >= 0; i++)
+			n = mNext[n];
+		outx = (n % mWidth) * mCellWidth;
+		outy = (n / mWidth) * mCellHeight;
+		return true;
+	}
+}
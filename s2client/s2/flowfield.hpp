@@ -0,0 +1,41 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <span>
+
+namespace s2 {
+	class navmesh2d;
+
+	// Shortest-path tree of a navmesh towards one goal cell: the integration field holds every
+	// cell's cost to reach the goal, and each cell points at the neighbour that continues the
+	// cheapest route. Built once per goal, after which any agent can look up its next step in O(1).
+	// Self-contained, so a field stays usable after the navmesh that built it is gone.
+	class flowfield {
+		int mGoal;
+		int mWidth, mHeight;
+		float mCellWidth, mCellHeight;
+		vector<float> mCost;
+		vector<int> mNext;
+
+		flowfield() = default;
+	public:
+		// Builds the field with a tiled label-correcting search on the thread pool. reverseOffsets
+		// and reverseLinks hold the navmesh's incoming links in CSR form (see navmesh2d::flowfieldto).
+		struct incominglink {
+			int from;
+			float cost;
+		};
+		static std::shared_ptr<flowfield> Build(const navmesh2d& navmesh, int goal, std::span<const uint32_t> reverseOffsets, std::span<const incominglink> reverseLinks);
+
+		int goal()const { return mGoal; }
+		bool reachable(int index)const { return mCost[index] != std::numeric_limits<float>::infinity(); }
+		// Cost to reach the goal from a node, infinity if it can't.
+		float cost(int index)const { return mCost[index]; }
+		// Next node on the way to the goal, -1 at the goal or if unreachable.
+		int next(int index)const { return mNext[index]; }
+
+		// World position 'lookahead' steps downstream of the cell containing (wx, wy); stops early
+		// at the goal. Returns false outside the grid or where the goal can't be reached.
+		bool waypoint(float wx, float wy, int lookahead, float& outx, float& outy)const;
+	};
+}
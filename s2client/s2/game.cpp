@@ -53,7 +53,16 @@ namespace s2 {
 		mEntities.clear();
 	}
 	bool game::loadworld(string_view worldname, string_view worldchecksum) {
-		mWorld = world::LoadFromFile(core::format("maps/%s_%s.s2z", worldname, worldchecksum));
+		// Routes cached against the old map must not be served to anyone still holding it.
+		if (mWorld)
+			mWorld->clearpathcache();
+		auto cachefile = core::format("maps/%s_%s.s2w", worldname, worldchecksum);
+		mWorld = world::LoadFromCache(cachefile);
+		if (!mWorld) {
+			mWorld = world::LoadFromFile(core::format("maps/%s_%s.s2z", worldname, worldchecksum));
+			if (mWorld)
+				mWorld->SaveCache(cachefile);
+		}
 		resetworld();
 		return mWorld != nullptr;
 	}
@@ -0,0 +1,396 @@
+#include "navhierarchy.hpp"
+
+#include <core/io/logger.hpp>
+#include <core/utils/threadpool.hpp>
+
+namespace s2 {
+	namespace {
+		constexpr float Unreached = std::numeric_limits<float>::infinity();
+		// Open border runs at least this long get a transition at each end instead of one in the middle.
+		constexpr int LongEntrance = 6;
+
+		struct searchentry {
+			float fs;
+			int n;
+			constexpr bool operator>(const searchentry& o)const { return fs > o.fs; }
+		};
+	}
+
+	navhierarchy::navhierarchy(std::shared_ptr<const navmesh2d> navmesh, int clusterSize)
+		: mNavmesh(std::move(navmesh)), mClusterSize(clusterSize), mClustersX(0), mClustersY(0) {
+	}
+
+	int navhierarchy::clusterof(int cell) const {
+		int w = mNavmesh->width();
+		return (cell / w / mClusterSize) * mClustersX + (cell % w / mClusterSize);
+	}
+
+	int navhierarchy::localindex(const cluster& c, int cell) const {
+		int w = mNavmesh->width();
+		return (cell / w - c.y0) * (c.x1 - c.x0) + (cell % w - c.x0);
+	}
+
+	float navhierarchy::linkcost(int fromCell, int toCell) const {
+		for (auto& link : mNavmesh->links(mNavmesh->get(fromCell))) {
+			if (link.to == toCell)
+				return link.cost;
+		}
+		return -1.f;
+	}
+
+	bool navhierarchy::searchcluster(const cluster& c, int srcCell, int dstCell, float* dist, int* parent) const {
+		int w = mNavmesh->width();
+		int ncells = (c.x1 - c.x0) * (c.y1 - c.y0);
+		std::fill(dist, dist + ncells, Unreached);
+		std::fill(parent, parent + ncells, -1);
+
+		float tox = 0.f, toy = 0.f;
+		if (dstCell >= 0) {
+			tox = mNavmesh->get(dstCell).worldx;
+			toy = mNavmesh->get(dstCell).worldy;
+		}
+		auto h = [&](int cell) -> float {
+			if (dstCell < 0)
+				return 0.f;
+			auto& n = mNavmesh->get(cell);
+			return sqrtf((n.worldx - tox) * (n.worldx - tox) + (n.worldy - toy) * (n.worldy - toy));
+		};
+
+		min_heap<searchentry> open;
+		dist[localindex(c, srcCell)] = 0.f;
+		open.push(searchentry{ .fs = h(srcCell), .n = srcCell });
+		while (!open.empty()) {
+			auto e = open.top();
+			open.pop();
+			float g = dist[localindex(c, e.n)];
+			if (e.fs > g + h(e.n))
+				continue;
+			if (e.n == dstCell)
+				return true;
+			for (auto& link : mNavmesh->links(mNavmesh->get(e.n))) {
+				int x = link.to % w, y = link.to / w;
+				if (x < c.x0 || x >= c.x1 || y < c.y0 || y >= c.y1)
+					continue;
+				int local = localindex(c, link.to);
+				float tentative = g + link.cost;
+				if (tentative < dist[local]) {
+					dist[local] = tentative;
+					parent[local] = e.n;
+					open.push(searchentry{ .fs = tentative + h(link.to), .n = link.to });
+				}
+			}
+		}
+		return dstCell < 0;
+	}
+
+	bool navhierarchy::refinesegment(int fromCell, int toCell, vector<int>& cells) const {
+		int cl = clusterof(fromCell);
+		// Consecutive waypoints in different clusters are the two sides of a transition, which is a single link.
+		if (cl != clusterof(toCell)) {
+			cells.push_back(toCell);
+			return true;
+		}
+		auto& c = mClusters[cl];
+		vector<float> dist(size_t(mClusterSize) * mClusterSize);
+		vector<int> parent(size_t(mClusterSize) * mClusterSize);
+		if (!searchcluster(c, fromCell, toCell, dist.data(), parent.data()))
+			return false;
+		size_t first = cells.size();
+		for (int cell = toCell; cell != fromCell; cell = parent[localindex(c, cell)])
+			cells.push_back(cell);
+		std::reverse(cells.begin() + first, cells.end());
+		return true;
+	}
+
+	bool navhierarchy::scanborder(int border) {
+		// Walks one cluster border; a and b step along the cells facing each other across it.
+		// Runs of pairs linked in both directions form an entrance.
+		int w = mNavmesh->width();
+		int ci = border / 2, cx = ci % mClustersX, cy = ci / mClustersX;
+		auto& c = mClusters[ci];
+		vector<transition> found;
+		int a = 0, b = 0, step = 0, length = 0;
+		if (border % 2 == 0 && cx + 1 < mClustersX) {
+			a = c.y0 * w + c.x1 - 1; b = c.y0 * w + c.x1; step = w; length = c.y1 - c.y0;
+		}
+		else if (border % 2 == 1 && cy + 1 < mClustersY) {
+			a = (c.y1 - 1) * w + c.x0; b = c.y1 * w + c.x0; step = 1; length = c.x1 - c.x0;
+		}
+		auto add = [&](int i) {
+			int ca = a + i * step, cb = b + i * step;
+			found.push_back(transition{ .a = ca, .b = cb, .ab = linkcost(ca, cb), .ba = linkcost(cb, ca) });
+		};
+		int runstart = -1;
+		for (int i = 0; i <= length && length > 0; i++) {
+			bool open = i < length
+				&& linkcost(a + i * step, b + i * step) >= 0.f
+				&& linkcost(b + i * step, a + i * step) >= 0.f;
+			if (open && runstart < 0) {
+				runstart = i;
+			}
+			else if (!open && runstart >= 0) {
+				if (i - runstart >= LongEntrance) {
+					add(runstart);
+					add(i - 1);
+				}
+				else {
+					add(runstart + (i - runstart) / 2);
+				}
+				runstart = -1;
+			}
+		}
+		if (found == mBorders[border])
+			return false;
+		mBorders[border] = std::move(found);
+		return true;
+	}
+
+	void navhierarchy::assignentrances() {
+		for (int cell : mEntranceCell)
+			mEntranceOf[cell] = -1;
+		mEntranceCell.clear();
+		mEntranceCluster.clear();
+		for (auto& c : mClusters)
+			c.entrances.clear();
+		auto addentrance = [&](int cell) {
+			if (mEntranceOf[cell] < 0) {
+				mEntranceOf[cell] = int(mEntranceCell.size());
+				mEntranceCell.push_back(cell);
+				mEntranceCluster.push_back(clusterof(cell));
+				mClusters[clusterof(cell)].entrances.push_back(mEntranceOf[cell]);
+			}
+		};
+		for (auto& border : mBorders) {
+			for (auto& t : border) {
+				addentrance(t.a);
+				addentrance(t.b);
+			}
+		}
+	}
+
+	void navhierarchy::buildintra(cluster& c) {
+		// One bounded Dijkstra per entrance.
+		vector<float> dist(size_t(mClusterSize) * mClusterSize);
+		vector<int> parent(size_t(mClusterSize) * mClusterSize);
+		c.intra.clear();
+		for (int e : c.entrances) {
+			searchcluster(c, mEntranceCell[e], -1, dist.data(), parent.data());
+			for (int o : c.entrances) {
+				float d = dist[localindex(c, mEntranceCell[o])];
+				if (o != e && d != Unreached)
+					c.intra.push_back(intralink{ .from = mEntranceCell[e], .to = mEntranceCell[o], .cost = d });
+			}
+		}
+	}
+
+	void navhierarchy::assemblelinks() {
+		mLinkOffsets.assign(mEntranceCell.size() + 1, 0);
+		for (auto& border : mBorders) {
+			for (auto& t : border) {
+				mLinkOffsets[mEntranceOf[t.a] + 1]++;
+				mLinkOffsets[mEntranceOf[t.b] + 1]++;
+			}
+		}
+		for (auto& c : mClusters)
+			for (auto& l : c.intra)
+				mLinkOffsets[mEntranceOf[l.from] + 1]++;
+		for (size_t i = 1; i < mLinkOffsets.size(); i++)
+			mLinkOffsets[i] += mLinkOffsets[i - 1];
+		mLinks.resize(mLinkOffsets.back());
+		vector<uint32_t> fill(mLinkOffsets.begin(), mLinkOffsets.end() - 1);
+		for (auto& border : mBorders) {
+			for (auto& t : border) {
+				int ea = mEntranceOf[t.a], eb = mEntranceOf[t.b];
+				mLinks[fill[ea]++] = abstractlink{ .to = eb, .cost = t.ab };
+				mLinks[fill[eb]++] = abstractlink{ .to = ea, .cost = t.ba };
+			}
+		}
+		for (auto& c : mClusters)
+			for (auto& l : c.intra)
+				mLinks[fill[mEntranceOf[l.from]]++] = abstractlink{ .to = mEntranceOf[l.to], .cost = l.cost };
+	}
+
+	int navhierarchy::build() {
+		auto start = high_resolution_clock::now();
+		int w = mNavmesh->width(), h = mNavmesh->height();
+		mClustersX = (w + mClusterSize - 1) / mClusterSize;
+		mClustersY = (h + mClusterSize - 1) / mClusterSize;
+		mClusters.clear();
+		mClusters.resize(size_t(mClustersX) * mClustersY);
+		for (int cy = 0; cy < mClustersY; cy++) {
+			for (int cx = 0; cx < mClustersX; cx++) {
+				auto& c = mClusters[size_t(cy) * mClustersX + cx];
+				c.x0 = cx * mClusterSize;
+				c.y0 = cy * mClusterSize;
+				c.x1 = min(w, c.x0 + mClusterSize);
+				c.y1 = min(h, c.y0 + mClusterSize);
+			}
+		}
+
+		mBorders.assign(mClusters.size() * 2, {});
+		for (int border = 0; border < int(mBorders.size()); border++)
+			scanborder(border);
+		mEntranceCell.clear();
+		mEntranceOf.assign(size_t(w) * h, -1);
+		assignentrances();
+		// Clusters are independent, so their intra-cluster costs are computed concurrently.
+		core::threadpool::Instance().parallel_for(int(mClusters.size()), [&](int ci, int) {
+			buildintra(mClusters[ci]);
+		});
+		assemblelinks();
+
+		double elapsed = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+		core::info("Built navigation hierarchy: %d clusters, %d entrances, %d links in %.2fms\n",
+			int(mClusters.size()), int(mEntranceCell.size()), int(mLinks.size()), elapsed);
+		return int(mLinks.size());
+	}
+
+	int navhierarchy::update(int x0, int y0, int x1, int y1) {
+		if (mClusters.empty() || x0 > x1 || y0 > y1)
+			return 0;
+		int cx0 = max(0, x0 / mClusterSize), cx1 = min(mClustersX - 1, x1 / mClusterSize);
+		int cy0 = max(0, y0 / mClusterSize), cy1 = min(mClustersY - 1, y1 / mClusterSize);
+		// Clusters holding changed nodes need new costs, and so do their neighbours across any
+		// border whose transitions moved, since those renumber the neighbour's entrances.
+		vector<int> dirty;
+		vector<bool> isdirty(mClusters.size(), false);
+		auto mark = [&](int ci) {
+			if (!isdirty[ci]) {
+				isdirty[ci] = true;
+				dirty.push_back(ci);
+			}
+		};
+		for (int cy = cy0; cy <= cy1; cy++) {
+			for (int cx = cx0; cx <= cx1; cx++) {
+				int ci = cy * mClustersX + cx;
+				mark(ci);
+				if (scanborder(2 * ci) && cx + 1 < mClustersX)
+					mark(ci + 1);
+				if (scanborder(2 * ci + 1) && cy + 1 < mClustersY)
+					mark(ci + mClustersX);
+				if (cx > 0 && scanborder(2 * (ci - 1)))
+					mark(ci - 1);
+				if (cy > 0 && scanborder(2 * (ci - mClustersX) + 1))
+					mark(ci - mClustersX);
+			}
+		}
+		assignentrances();
+		core::threadpool::Instance().parallel_for(int(dirty.size()), [&](int i, int) {
+			buildintra(mClusters[dirty[i]]);
+		});
+		assemblelinks();
+		return int(dirty.size());
+	}
+
+	deque<std::pair<float, float>> navhierarchy::pathfind(float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&, const vector3f&)>& prArrived, int refineSegments, int* numRefined) const {
+		deque<std::pair<float, float>> result;
+		if (numRefined)
+			*numRefined = 0;
+
+		int w = mNavmesh->width(), h = mNavmesh->height();
+		int fromxcell = int(fromx / mNavmesh->cellwidth()), fromycell = int(fromy / mNavmesh->cellheight());
+		int toxcell = int(tox / mNavmesh->cellwidth()), toycell = int(toy / mNavmesh->cellheight());
+		if (fromxcell < 0 || fromycell < 0 || fromxcell >= w || fromycell >= h)
+			return result;
+		if (toxcell < 0 || toycell < 0 || toxcell >= w || toycell >= h)
+			return result;
+		int srcCell = fromycell * w + fromxcell;
+		int dstCell = toycell * w + toxcell;
+
+		auto flat = [&]() {
+			auto path = mNavmesh->pathfind(fromx, fromy, tox, toy, prArrived);
+			if (numRefined)
+				*numRefined = int(path.size());
+			return path;
+		};
+		if (mClusters.empty() || clusterof(srcCell) == clusterof(dstCell))
+			return flat();
+
+		vector3f dst(tox, toy, 0.f);
+		auto arrived = [&](int cell) -> bool {
+			auto& n = mNavmesh->get(cell);
+			if (!prArrived) {
+				float dist = (vector3f(n.worldx, n.worldy, 0.f) - dst).length();
+				return (dist <= 1.2f * mNavmesh->cellwidth() || dist <= 1.2f * mNavmesh->cellheight());
+			}
+			return prArrived(vector3f(n.worldx, n.worldy, 0.f), dst);
+		};
+
+		// The start and goal cells join the abstract graph as two temporary nodes, connected to
+		// the entrances of their clusters. Costs into the goal come from a search out of the goal
+		// cell; links are symmetric wherever both directions exist, and refinement re-checks them.
+		auto& srcCluster = mClusters[clusterof(srcCell)];
+		auto& dstCluster = mClusters[clusterof(dstCell)];
+		size_t clustercells = size_t(mClusterSize) * mClusterSize;
+		vector<float> srcDist(clustercells), dstDist(clustercells);
+		vector<int> parent(clustercells);
+		searchcluster(srcCluster, srcCell, -1, srcDist.data(), parent.data());
+		searchcluster(dstCluster, dstCell, -1, dstDist.data(), parent.data());
+
+		int nentrances = int(mEntranceCell.size());
+		int srcNode = nentrances, dstNode = nentrances + 1;
+		int dstClusterIndex = clusterof(dstCell);
+		auto cellof = [&](int n) { return n == srcNode ? srcCell : n == dstNode ? dstCell : mEntranceCell[n]; };
+		auto heuristic = [&](int n) -> float {
+			auto& node = mNavmesh->get(cellof(n));
+			return sqrtf((node.worldx - tox) * (node.worldx - tox) + (node.worldy - toy) * (node.worldy - toy));
+		};
+
+		// The abstract graph has its own context so the grid-sized ThreadInstance() isn't resized.
+		thread_local navsearch ctx;
+		ctx.begin(size_t(nentrances) + 2);
+		ctx.relax(srcNode, -1, 0.f, heuristic(srcNode));
+		int goal = -1;
+		while (!ctx.empty()) {
+			int n = ctx.pop();
+			if (n == dstNode || arrived(cellof(n))) {
+				goal = n;
+				break;
+			}
+			float g = ctx.gscore(n);
+			auto relax = [&](int to, float cost) {
+				ctx.relax(to, n, g + cost, g + cost + heuristic(to));
+			};
+			if (n == srcNode) {
+				for (int a : srcCluster.entrances) {
+					float d = srcDist[localindex(srcCluster, mEntranceCell[a])];
+					if (d != Unreached)
+						relax(a, d);
+				}
+				continue;
+			}
+			for (uint32_t i = mLinkOffsets[n]; i < mLinkOffsets[n + 1]; i++)
+				relax(mLinks[i].to, mLinks[i].cost);
+			if (mEntranceCluster[n] == dstClusterIndex) {
+				float d = dstDist[localindex(dstCluster, mEntranceCell[n])];
+				if (d != Unreached)
+					relax(dstNode, d);
+			}
+		}
+		// HPA* only keeps representative transitions per border, so fall back to the exact search
+		// rather than report a goal unreachable that the grid can still reach.
+		if (goal < 0)
+			return flat();
+
+		vector<int> waypoints;
+		for (int n : ctx.reconstruct(goal))
+			waypoints.push_back(cellof(n));
+
+		vector<int> cells{ waypoints.front() };
+		size_t segment = 0;
+		for (; segment + 1 < waypoints.size() && int(segment) < refineSegments; segment++) {
+			if (!refinesegment(waypoints[segment], waypoints[segment + 1], cells))
+				return flat();
+		}
+		int refined = int(cells.size());
+		cells.insert(cells.end(), waypoints.begin() + segment + 1, waypoints.end());
+
+		for (int cell : cells) {
+			auto& n = mNavmesh->get(cell);
+			result.push_back({ n.worldx, n.worldy });
+		}
+		if (numRefined)
+			*numRefined = refined;
+		return result;
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <core/math/vector3.hpp>
+#include <s2/navmesh2d.hpp>
+
+namespace s2 {
+	// Hierarchical (HPA*) layer over a navmesh2d. The grid is cut into square clusters; cells
+	// on either side of an open cluster border become entrance nodes, and every pair of
+	// entrances inside a cluster is joined by its precomputed shortest in-cluster cost.
+	// Long queries search this small abstract graph and only expand the first few segments
+	// back into grid cells, leaving the rest as coarse waypoints to be refined later.
+	class navhierarchy {
+	public:
+		static constexpr int DefaultClusterSize = 16;
+		static constexpr int DefaultRefineSegments = 4;
+		struct abstractlink {
+			int to;
+			float cost;
+		};
+	private:
+		// Costs are kept between cells rather than entrance indices, so clusters that update()
+		// doesn't touch keep theirs when entrances are renumbered.
+		struct intralink {
+			int from, to;
+			float cost;
+		};
+		struct transition {
+			int a, b;
+			float ab, ba;
+			bool operator==(const transition&)const = default;
+		};
+		struct cluster {
+			int x0, y0, x1, y1;
+			vector<int> entrances;
+			vector<intralink> intra;
+		};
+		std::shared_ptr<const navmesh2d> mNavmesh;
+		int mClusterSize;
+		int mClustersX, mClustersY;
+		vector<cluster> mClusters;
+		// Transitions on the east (2 * cluster) and south (2 * cluster + 1) border of every cluster.
+		vector<vector<transition>> mBorders;
+		// Abstract nodes: navmesh node index and owning cluster of every entrance.
+		vector<int> mEntranceCell;
+		vector<int> mEntranceCluster;
+		// Entrance index of every grid cell, -1 for cells that aren't one.
+		vector<int> mEntranceOf;
+		// CSR adjacency of the abstract graph, same layout as navmesh2d.
+		vector<uint32_t> mLinkOffsets;
+		vector<abstractlink> mLinks;
+
+		int clusterof(int cell)const;
+		int localindex(const cluster& c, int cell)const;
+		float linkcost(int fromCell, int toCell)const;
+		// Dijkstra (or A* when dstCell >= 0) restricted to the cells of one cluster.
+		// dist and parent are indexed by cluster-local cell and must hold clusterSize^2 entries.
+		bool searchcluster(const cluster& c, int srcCell, int dstCell, float* dist, int* parent)const;
+		bool refinesegment(int fromCell, int toCell, vector<int>& cells)const;
+		// Rescans one border; returns whether its transitions changed.
+		bool scanborder(int border);
+		void assignentrances();
+		void buildintra(cluster& c);
+		void assemblelinks();
+	public:
+		navhierarchy(std::shared_ptr<const navmesh2d> navmesh, int clusterSize = DefaultClusterSize);
+		navhierarchy(const navhierarchy&) = delete;
+		navhierarchy& operator=(const navhierarchy&) = delete;
+
+		// Finds cluster entrances and precomputes intra-cluster costs; returns the number of abstract links.
+		int build();
+		// Brings the graph up to date after the links of the nodes in the inclusive cell range
+		// changed, redoing only the borders and clusters involved; returns the number of clusters
+		// whose costs were recomputed. The result matches a fresh build().
+		int update(int x0, int y0, int x1, int y1);
+
+		int clustersize()const { return mClusterSize; }
+		size_t numentrances()const { return mEntranceCell.size(); }
+		size_t numlinks()const { return mLinks.size(); }
+
+		// Same contract as navmesh2d::pathfind. The first refineSegments abstract segments are
+		// expanded to grid cells; the remaining waypoints are cluster entrances. numRefined
+		// receives the number of leading waypoints that are grid-accurate.
+		deque<std::pair<float, float>> pathfind(float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&, const vector3f&)>& prArrived = nullptr, int refineSegments = DefaultRefineSegments, int* numRefined = nullptr)const;
+	};
+}
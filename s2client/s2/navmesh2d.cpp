@@ -1,5 +1,7 @@
 #include "navmesh2d.hpp"
 
+#include <core/utils/threadpool.hpp>
+
 namespace s2 {
 	navmesh2d::navmesh2d(int width, int height, float worldWidth, float worldHeight)
 		: mWidth(width), mHeight(height), mWorldWidth(worldWidth), mWorldHeight(worldHeight) {
@@ -11,11 +13,13 @@ namespace s2 {
 				mGraph[size_t(y) * mWidth + x] = node{
 					.worldx = x * mCellWidth,
 					.worldy = y * mCellHeight,
-					.index = (y * mWidth + x),
-					.reachable = { }
+					.index = (y * mWidth + x)
 				};
 			}
 		}
+		mLinkOffsets.assign(mGraph.size() + 1, 0);
+		mOffsetsView = mLinkOffsets;
+		resetlinkends();
 	}
 
 	const navmesh2d::node& navmesh2d::get(int x, int y) const {
@@ -30,43 +34,255 @@ namespace s2 {
 		return mGraph[size_t(worldytocell(wy)) * mWidth + worldxtocell(wx)];
 	}
 
-	int navmesh2d::generate(std::function<bool(float, float, float, float)> fnObstructed, float capsuleWidth) {
-		int numlinks = 0;
-		for (int y = 0; y < mHeight; y++) {
-			for (int x = 0; x < mWidth; x++) {
-				auto& node = get(x, y);
-				for (int oy = -2; oy <= 2; oy++) {
-					for (int ox = -2; ox <= 2; ox++) {
-						if (ox == 0 && oy == 0)
-							continue;
-						if ((-ox) > x || (-oy) > y || ((x + ox) >= mWidth) || (y + oy) >= mHeight) {
-							continue;
-						}
-                        vector3f from(x * mCellWidth, y * mCellHeight, 0.f);
-						vector3f to((x + ox) * mCellWidth, (y + oy) * mCellHeight, 0.f);
-                        vector3f capsuleRight = (to - from).perp2d().unit() * capsuleWidth;
-						if (fnObstructed(from.x, from.y, to.x, to.y)
-                         || fnObstructed(from.x + capsuleRight.x, from.y + capsuleRight.y,
-                                        to.x + capsuleRight.x, to.y + capsuleRight.y)
-                         || fnObstructed(from.x - capsuleRight.x, from.y - capsuleRight.y,
-                                        to.x - capsuleRight.x, to.y - capsuleRight.y))
-                            continue;
-						float dx = ox * mCellWidth;
-						float dy = oy * mCellHeight;
-						float cost = sqrtf(dx * dx + dy * dy);
-						node.reachable.push_back(navmesh2d::nodelink<navmesh2d::node>{
-							.to = get(x + ox, y + oy),
-							.cost = cost
-						});
-						numlinks++;
+	int navmesh2d::linknode(int x, int y, const ObstructionTest& fnObstructed, const ClearanceTest& fnClearance, float capsuleWidth, nodelink* out, const core::rect* dirty, std::span<const nodelink> current) const {
+		const int maxrays = MaxNodeLinks * 3;
+		float rx0[maxrays], ry0[maxrays], rx1[maxrays], ry1[maxrays];
+		bool obstructed[maxrays];
+		int targets[MaxNodeLinks];
+		// -1: test the capsule, otherwise the link's known state.
+		int known[MaxNodeLinks];
+		// Targets still to test and their positions, in target order.
+		int pending[MaxNodeLinks];
+		float tx[MaxNodeLinks], ty[MaxNodeLinks];
+		int ntargets = 0, npending = 0, nrays = 0;
+		vector3f from(x * mCellWidth, y * mCellHeight, 0.f);
+		for (int oy = -2; oy <= 2; oy++) {
+			for (int ox = -2; ox <= 2; ox++) {
+				if (ox == 0 && oy == 0)
+					continue;
+				if ((-ox) > x || (-oy) > y || ((x + ox) >= mWidth) || (y + oy) >= mHeight) {
+					continue;
+				}
+				vector3f to((x + ox) * mCellWidth, (y + oy) * mCellHeight, 0.f);
+				int t = ntargets++;
+				targets[t] = (oy + 2) * 5 + (ox + 2);
+				known[t] = -1;
+				if (dirty) {
+					// Rays are clamped to the grid before they are walked, so clamp their bounds too.
+					float bx0 = max(0.f, min(from.x, to.x) - capsuleWidth), bx1 = min(mWorldWidth, max(from.x, to.x) + capsuleWidth);
+					float by0 = max(0.f, min(from.y, to.y) - capsuleWidth), by1 = min(mWorldHeight, max(from.y, to.y) + capsuleWidth);
+					if (bx1 < dirty->x || bx0 > dirty->x + dirty->w || by1 < dirty->y || by0 > dirty->y + dirty->h) {
+						int index = (y + oy) * mWidth + (x + ox);
+						known[t] = std::any_of(current.begin(), current.end(), [index](const nodelink& l) { return l.to == index; });
+						continue;
 					}
 				}
+				pending[npending] = t;
+				tx[npending] = to.x;
+				ty[npending] = to.y;
+				npending++;
+			}
+		}
+		if (fnClearance && npending > 0) {
+			linkstate states[MaxNodeLinks];
+			fnClearance(from.x, from.y, tx, ty, npending, states);
+			for (int i = 0; i < npending; i++) {
+				if (states[i] != linkstate::unknown)
+					known[pending[i]] = states[i] == linkstate::open;
 			}
 		}
-		return numlinks;
+		for (int i = 0; i < npending; i++) {
+			if (known[pending[i]] >= 0)
+				continue;
+			vector3f to(tx[i], ty[i], 0.f);
+			vector3f capsuleRight = (to - from).perp2d().unit() * capsuleWidth;
+			for (float side : { 0.f, 1.f, -1.f }) {
+				rx0[nrays] = from.x + side * capsuleRight.x;
+				ry0[nrays] = from.y + side * capsuleRight.y;
+				rx1[nrays] = to.x + side * capsuleRight.x;
+				ry1[nrays] = to.y + side * capsuleRight.y;
+				nrays++;
+			}
+		}
+		if (nrays > 0)
+			fnObstructed(rx0, ry0, rx1, ry1, nrays, obstructed);
+		int nlinks = 0;
+		for (int t = 0, ray = 0; t < ntargets; t++) {
+			bool open;
+			if (known[t] >= 0) {
+				open = known[t] != 0;
+			}
+			else {
+				open = !obstructed[ray] && !obstructed[ray + 1] && !obstructed[ray + 2];
+				ray += 3;
+			}
+			if (!open)
+				continue;
+			int ox = targets[t] % 5 - 2, oy = targets[t] / 5 - 2;
+			float dx = ox * mCellWidth;
+			float dy = oy * mCellHeight;
+			out[nlinks++] = nodelink{
+				.to = (y + oy) * mWidth + (x + ox),
+				.cost = sqrtf(dx * dx + dy * dy)
+			};
+		}
+		return nlinks;
 	}
-	deque<std::pair<float, float>> navmesh2d::pathfind(float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&,const vector3f&)>& prArrived) const {
-		deque<std::pair<float, float>> result;
+
+	int navmesh2d::generate(const ObstructionTest& fnObstructed, float capsuleWidth, const ClearanceTest& fnClearance) {
+		// Rows are split into bands that are linked concurrently. Each band collects its links
+		// into one local array and stores per-node counts in mLinkOffsets; a prefix sum then
+		// turns the counts into offsets and the band arrays are packed into mLinks in order.
+		// A node's three capsule rays per neighbour are handed to fnObstructed as one batch.
+		const int bandrows = 4;
+		int nbands = (mHeight + bandrows - 1) / bandrows;
+		vector<vector<nodelink>> bands(nbands);
+		mLinkOffsets.assign(mGraph.size() + 1, 0);
+		core::threadpool::Instance().parallel_for(nbands, [&](int band, int) {
+			auto& links = bands[band];
+			int y0 = band * bandrows, y1 = min(mHeight, y0 + bandrows);
+			links.reserve(size_t(y1 - y0) * mWidth * 8);
+			for (int y = y0; y < y1; y++) {
+				for (int x = 0; x < mWidth; x++) {
+					nodelink out[MaxNodeLinks];
+					int n = linknode(x, y, fnObstructed, fnClearance, capsuleWidth, out);
+					links.insert(links.end(), out, out + n);
+					mLinkOffsets[size_t(y) * mWidth + x + 1] = uint32_t(n);
+				}
+			}
+		});
+
+		for (size_t i = 1; i < mLinkOffsets.size(); i++)
+			mLinkOffsets[i] += mLinkOffsets[i - 1];
+		mLinks.clear();
+		mLinks.reserve(mLinkOffsets.back());
+		for (auto& band : bands)
+			mLinks.insert(mLinks.end(), band.begin(), band.end());
+		assert(mLinks.size() == mLinkOffsets.back());
+		mOffsetsView = mLinkOffsets;
+		mLinksView = mLinks;
+		resetlinkends();
+		resetflowfields();
+		return int(mLinks.size());
+	}
+
+	navmesh2d::cellrange navmesh2d::relink(const core::rect& dirty, const ObstructionTest& fnObstructed, float capsuleWidth, const ClearanceTest& fnClearance) {
+		// Links reach two cells and their capsules capsuleWidth beyond that.
+		float reach = 2.f * max(mCellWidth, mCellHeight) + capsuleWidth;
+		int nx0 = max(0, int(std::floor((dirty.x - reach) / mCellWidth)));
+		int ny0 = max(0, int(std::floor((dirty.y - reach) / mCellHeight)));
+		int nx1 = min(mWidth - 1, int(std::ceil((dirty.x + dirty.w + reach) / mCellWidth)));
+		int ny1 = min(mHeight - 1, int(std::ceil((dirty.y + dirty.h + reach) / mCellHeight)));
+
+		// Edits need owned storage; a navmesh attached to a mapped cache is copied once.
+		if (mLinksView.data() != mLinks.data() || mOffsetsView.data() != mLinkOffsets.data()) {
+			mLinkOffsets.assign(mOffsetsView.begin(), mOffsetsView.end());
+			mLinks.assign(mLinksView.begin(), mLinksView.end());
+			mOffsetsView = mLinkOffsets;
+			mLinksView = mLinks;
+		}
+
+		cellrange changed{ mWidth, mHeight, -1, -1 };
+		for (int y = ny0; y <= ny1; y++) {
+			for (int x = nx0; x <= nx1; x++) {
+				auto& n = get(x, y);
+				nodelink out[MaxNodeLinks];
+				auto current = links(n);
+				int count = linknode(x, y, fnObstructed, fnClearance, capsuleWidth, out, &dirty, current);
+				if (count == int(current.size()) && std::equal(out, out + count, current.begin(), [](const nodelink& a, const nodelink& b) { return a.to == b.to; }))
+					continue;
+				uint32_t capacity = mLinkOffsets[n.index + 1] - mLinkOffsets[n.index];
+				assert(uint32_t(count) <= capacity);
+				count = min(count, int(capacity));
+				std::copy(out, out + count, mLinks.begin() + mLinkOffsets[n.index]);
+				mNumLinks = mNumLinks - current.size() + count;
+				mLinkEnds[n.index] = mLinkOffsets[n.index] + count;
+				changed.x0 = min(changed.x0, x); changed.y0 = min(changed.y0, y);
+				changed.x1 = max(changed.x1, x); changed.y1 = max(changed.y1, y);
+			}
+		}
+		if (!changed.empty())
+			resetflowfields();
+		return changed;
+	}
+
+	bool navmesh2d::attachlinks(std::span<const uint32_t> offsets, std::span<const nodelink> links) {
+		if (offsets.size() != mGraph.size() + 1 || offsets.front() != 0 || offsets.back() != links.size())
+			return false;
+		// The arrays may come from a damaged file; every row must lie inside the link array and
+		// every link must lead to a node of this grid.
+		for (size_t i = 1; i < offsets.size(); i++) {
+			if (offsets[i] < offsets[i - 1])
+				return false;
+		}
+		for (auto& link : links) {
+			if (link.to < 0 || size_t(link.to) >= mGraph.size())
+				return false;
+		}
+		mLinkOffsets.clear(); mLinkOffsets.shrink_to_fit();
+		mLinks.clear(); mLinks.shrink_to_fit();
+		mOffsetsView = offsets;
+		mLinksView = links;
+		resetlinkends();
+		resetflowfields();
+		return true;
+	}
+	void navmesh2d::resetlinkends() {
+		mLinkEnds.assign(mOffsetsView.begin() + 1, mOffsetsView.end());
+		mNumLinks = mLinksView.size();
+	}
+	void navmesh2d::resetflowfields() {
+		std::lock_guard<std::mutex> lock(mFlowMutex);
+		mReverseOffsets.clear();
+		mReverseLinks.clear();
+		mFlowFields.clear();
+	}
+
+	void navmesh2d::buildreverselinks() const {
+		if (!mReverseOffsets.empty())
+			return;
+		mReverseOffsets.assign(mGraph.size() + 1, 0);
+		for (auto& n : mGraph) {
+			for (auto& link : links(n))
+				mReverseOffsets[link.to + 1]++;
+		}
+		for (size_t i = 1; i < mReverseOffsets.size(); i++)
+			mReverseOffsets[i] += mReverseOffsets[i - 1];
+		mReverseLinks.resize(mNumLinks);
+		vector<uint32_t> fill(mReverseOffsets.begin(), mReverseOffsets.end() - 1);
+		for (auto& n : mGraph) {
+			for (auto& link : links(n))
+				mReverseLinks[fill[link.to]++] = flowfield::incominglink{ .from = n.index, .cost = link.cost };
+		}
+	}
+
+	std::shared_ptr<const flowfield> navmesh2d::cachedflowfield(int goal) const {
+		std::lock_guard<std::mutex> lock(mFlowMutex);
+		for (auto it = mFlowFields.begin(); it != mFlowFields.end(); ++it) {
+			if ((*it)->goal() == goal) {
+				std::rotate(mFlowFields.begin(), it, it + 1);
+				return mFlowFields.front();
+			}
+		}
+		return nullptr;
+	}
+
+	std::shared_ptr<const flowfield> navmesh2d::flowfieldto(int goal) const {
+		if (goal < 0 || goal >= int(mGraph.size()))
+			return nullptr;
+		if (auto field = cachedflowfield(goal))
+			return field;
+		std::unique_lock<std::mutex> lock(mFlowMutex);
+		buildreverselinks();
+		// The reverse links only change in relink(), which can't run alongside queries, so the
+		// build reads them unlocked and lookups of other fields aren't held up behind it.
+		lock.unlock();
+		auto field = flowfield::Build(*this, goal, mReverseOffsets, mReverseLinks);
+		lock.lock();
+		// Another thread may have built the same field meanwhile; keep the one already shared.
+		for (auto it = mFlowFields.begin(); it != mFlowFields.end(); ++it) {
+			if ((*it)->goal() == goal) {
+				std::rotate(mFlowFields.begin(), it, it + 1);
+				return mFlowFields.front();
+			}
+		}
+		mFlowFields.insert(mFlowFields.begin(), std::move(field));
+		if (mFlowFields.size() > MaxFlowFields)
+			mFlowFields.pop_back();
+		return mFlowFields.front();
+	}
+
+	std::span<const int> navmesh2d::pathfind(navsearch& ctx, float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&,const vector3f&)>& prArrived) const {
 		vector3f src(fromx, fromy, 0.f);
 		vector3f dst(tox, toy, 0.f);
 		float epsilon = 1.f;
@@ -79,73 +295,164 @@ namespace s2 {
 		auto toxcell = worldxtocell(tox);
 		auto toycell = worldytocell(toy);
 		if (fromxcell < 0 || fromycell < 0 || fromxcell >= mWidth || fromycell >= mHeight)
-			return result;
+			return {};
 		if (toxcell < 0 || toycell < 0 || toxcell >= mWidth || toycell >= mHeight)
-			return result;
-
+			return {};
 
 		auto& srcn = getworld(src.x, src.y);
-		map<const node*, float> gScore;
-		gScore[&srcn] = 0.f;
-		map<const node*, float> fScore;
-		fScore[&srcn] = h(src.x, src.y);
-
-		map<const node*, const node*> cameFrom;
-
-		struct entry {
-			float fs;
-			const navmesh2d::node* n;
-			entry& operator=(const entry&) = default;
-			constexpr bool operator>(const entry& o)const { return fs > o.fs; }
-		};
-		min_heap<entry> qs;
-
-		qs.push(entry{
-			.fs=fScore[&srcn],
-			.n=&srcn
-		});
-		while (!qs.empty()) {
-			entry e = qs.top();
-			qs.pop();
+		ctx.begin(mGraph.size());
+		ctx.relax(srcn.index, -1, 0.f, h(src.x, src.y));
+		while (!ctx.empty()) {
+			auto& n = mGraph[ctx.pop()];
 
 			bool arrived = false;
 			if (!prArrived) {
-				float dist = (vector3f(e.n->worldx, e.n->worldy, 0.f) - dst).length();
+				float dist = (vector3f(n.worldx, n.worldy, 0.f) - dst).length();
 				arrived = (dist <= 1.2f * mCellWidth || dist <= 1.2f * mCellHeight);
 			}
 			else {
-				arrived = prArrived(vector3f(e.n->worldx, e.n->worldy, 0.f), dst);
+				arrived = prArrived(vector3f(n.worldx, n.worldy, 0.f), dst);
 			}
 
-			if (arrived) {
-				result.push_back({ e.n->worldx, e.n->worldy });
-				const node* curr = e.n;
-				auto it = cameFrom.find(curr);
-				while (it != cameFrom.end()) {
-					curr = it->second;
-					it = cameFrom.find(curr);
-					result.insert(result.begin(), { curr->worldx, curr->worldy });
+			if (arrived)
+				return ctx.reconstruct(n.index);
+
+			float nscore = ctx.gscore(n.index);
+			for (auto& link : links(n)) {
+				auto& to = mGraph[link.to];
+				float tentative = nscore + link.cost;
+				ctx.relax(link.to, n.index, tentative, tentative + h(to.worldx, to.worldy));
+			}
+		}
+
+		return {};
+	}
+
+	deque<std::pair<float, float>> navmesh2d::pathfind(float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&,const vector3f&)>& prArrived) const {
+		deque<std::pair<float, float>> result;
+		for (int index : pathfind(navsearch::ThreadInstance(), fromx, fromy, tox, toy, prArrived))
+			result.push_back({ mGraph[index].worldx, mGraph[index].worldy });
+		return result;
+	}
+
+	std::span<const int> navmesh2d::pathfindany(navsearch& ctx, float fromx, float fromy, std::span<const vector3f> goals, int* goalIndex) const {
+		if (goalIndex)
+			*goalIndex = -1;
+		int src = indexat(fromx, fromy);
+		if (src < 0)
+			return {};
+		// Distance to the closest goal inside the grid, and which one it is.
+		auto nearest = [&](float wx, float wy, int& which) -> float {
+			float best = std::numeric_limits<float>::infinity();
+			which = -1;
+			for (int i = 0; i < int(goals.size()); i++) {
+				if (indexat(goals[i].x, goals[i].y) < 0)
+					continue;
+				float d = (wx - goals[i].x) * (wx - goals[i].x) + (wy - goals[i].y) * (wy - goals[i].y);
+				if (d < best) {
+					best = d;
+					which = i;
 				}
-				break;
+			}
+			return sqrtf(best);
+		};
+		int which;
+		if (nearest(fromx, fromy, which) == std::numeric_limits<float>::infinity())
+			return {};
+
+		const float arrival = 1.2f * max(mCellWidth, mCellHeight);
+		ctx.begin(mGraph.size());
+		ctx.relax(src, -1, 0.f, nearest(fromx, fromy, which));
+		while (!ctx.empty()) {
+			auto& n = mGraph[ctx.pop()];
+			if (nearest(n.worldx, n.worldy, which) <= arrival) {
+				if (goalIndex)
+					*goalIndex = which;
+				return ctx.reconstruct(n.index);
 			}
 
-			float nscore = gScore[e.n];
-			for (auto& link : e.n->reachable) {
+			float nscore = ctx.gscore(n.index);
+			for (auto& link : links(n)) {
+				auto& to = mGraph[link.to];
 				float tentative = nscore + link.cost;
-				float tentative_fs = tentative + h(link.to.worldx, link.to.worldy);
-				auto vgs = gScore.find(&link.to);
-				if (vgs == gScore.end() || tentative < vgs->second) {
-					cameFrom[&link.to] = e.n;
-					gScore[&link.to] = tentative;
-					fScore[&link.to] = tentative_fs;
-					qs.push(entry{
-						.fs = tentative_fs,
-						.n = &link.to
-					});
+				ctx.relax(link.to, n.index, tentative, tentative + nearest(to.worldx, to.worldy, which));
+			}
+		}
+
+		return {};
+	}
+
+	deque<std::pair<float, float>> navmesh2d::pathfindany(float fromx, float fromy, std::span<const vector3f> goals, int* goalIndex) const {
+		deque<std::pair<float, float>> result;
+		for (int index : pathfindany(navsearch::ThreadInstance(), fromx, fromy, goals, goalIndex))
+			result.push_back({ mGraph[index].worldx, mGraph[index].worldy });
+		return result;
+	}
+
+	std::span<const int> navmesh2d::pathfindbidirectional(navsearch& forward, navsearch& backward, float fromx, float fromy, float tox, float toy) const {
+		int src = indexat(fromx, fromy), dst = indexat(tox, toy);
+		if (src < 0 || dst < 0)
+			return {};
+		{
+			std::lock_guard<std::mutex> lock(mFlowMutex);
+			buildreverselinks();
+		}
+
+		auto& s = mGraph[src];
+		auto& t = mGraph[dst];
+		// Forward keys use p(n) = (|n - t| - |n - s|) / 2 and backward keys -p(n). Then the search
+		// can stop once the two smallest keys add up to the best meeting cost found.
+		auto potential = [&](const node& n) -> float {
+			float ht = sqrtf((n.worldx - t.worldx) * (n.worldx - t.worldx) + (n.worldy - t.worldy) * (n.worldy - t.worldy));
+			float hs = sqrtf((n.worldx - s.worldx) * (n.worldx - s.worldx) + (n.worldy - s.worldy) * (n.worldy - s.worldy));
+			return 0.5f * (ht - hs);
+		};
+		forward.begin(mGraph.size());
+		backward.begin(mGraph.size());
+		forward.relax(src, -1, 0.f, potential(s));
+		backward.relax(dst, -1, 0.f, -potential(t));
+		float best = src == dst ? 0.f : std::numeric_limits<float>::infinity();
+		int meet = src == dst ? src : -1;
+		while (!forward.empty() && !backward.empty() && forward.topf() + backward.topf() < best) {
+			if (forward.topf() <= backward.topf()) {
+				int u = forward.pop();
+				float g = forward.gscore(u);
+				for (auto& link : links(mGraph[u])) {
+					float tentative = g + link.cost;
+					forward.relax(link.to, u, tentative, tentative + potential(mGraph[link.to]));
+					float total = tentative + backward.gscore(link.to);
+					if (total < best) {
+						best = total;
+						meet = link.to;
+					}
+				}
+			}
+			else {
+				int u = backward.pop();
+				float g = backward.gscore(u);
+				for (uint32_t i = mReverseOffsets[u]; i < mReverseOffsets[u + 1]; i++) {
+					auto& link = mReverseLinks[i];
+					float tentative = g + link.cost;
+					backward.relax(link.from, u, tentative, tentative - potential(mGraph[link.from]));
+					float total = tentative + forward.gscore(link.from);
+					if (total < best) {
+						best = total;
+						meet = link.from;
+					}
 				}
 			}
 		}
+		if (meet < 0)
+			return {};
+		return forward.reconstruct(meet, backward);
+	}
 
+	deque<std::pair<float, float>> navmesh2d::pathfindbidirectional(float fromx, float fromy, float tox, float toy) const {
+		// A second context for the backward half, like navhierarchy keeps for its abstract graph.
+		thread_local navsearch backward;
+		deque<std::pair<float, float>> result;
+		for (int index : pathfindbidirectional(navsearch::ThreadInstance(), backward, fromx, fromy, tox, toy))
+			result.push_back({ mGraph[index].worldx, mGraph[index].worldy });
 		return result;
 	}
 }
@@ -2,38 +2,134 @@
 
 #include <core/prerequisites.hpp>
 #include <core/math/vector3.hpp>
+#include <s2/navsearch.hpp>
+#include <s2/flowfield.hpp>
+#include <core/utils/quadtree.hpp>
+#include <span>
+#include <mutex>
 
 namespace s2 {
 	class navmesh2d {
-		template<typename T>
+	public:
 		struct nodelink {
-			T& to;
+			int to;
 			float cost;
 		};
 		struct node {
 			float worldx, worldy;
 			int index;
-			vector<nodelink<node>> reachable;
 		};
+		// Sets obstructed[i] for each of count lines (x0[i], y0[i]) -> (x1[i], y1[i]).
+		typedef std::function<void(const float* x0, const float* y0, const float* x1, const float* y1, int count, bool* obstructed)> ObstructionTest;
+		enum class linkstate { obstructed, open, unknown };
+		// Optional cheaper test run before the capsule rays: sets states[i] for each of count links
+		// from (x0, y0) to (x1[i], y1[i]), and only links it leaves unknown get the rays cast.
+		typedef std::function<void(float x0, float y0, const float* x1, const float* y1, int count, linkstate* states)> ClearanceTest;
+	private:
 		vector<node> mGraph;
+		// CSR adjacency: node i owns slots mLinks[mLinkOffsets[i] .. mLinkOffsets[i+1]) and its
+		// links are mLinks[mLinkOffsets[i] .. mLinkEnds[i]).
+		// Queries go through the spans, which point either at the vectors or at attached
+		// external storage such as a mapped world cache.
+		vector<uint32_t> mLinkOffsets;
+		vector<nodelink> mLinks;
+		std::span<const uint32_t> mOffsetsView;
+		std::span<const nodelink> mLinksView;
+		// Ends match the next node's offset until relink() removes links. A node never has more
+		// links than it was generated with, so relink() rewrites them in place.
+		vector<uint32_t> mLinkEnds;
+		size_t mNumLinks = 0;
+		// Incoming links in CSR form and the most recently used flow fields, both built on demand.
+		// mFlowMutex guards the containers; once built, the reverse links only change in relink().
+		mutable std::mutex mFlowMutex;
+		mutable vector<uint32_t> mReverseOffsets;
+		mutable vector<flowfield::incominglink> mReverseLinks;
+		mutable vector<std::shared_ptr<const flowfield>> mFlowFields;
 		int mWidth, mHeight;
 		float mWorldWidth, mWorldHeight;
 		float mCellWidth, mCellHeight;
 
 		inline int worldxtocell(float wx)const { return int(wx / mCellWidth);  }
 		inline int worldytocell(float wy)const { return int(wy / mCellHeight); }
+		void resetflowfields();
+		void resetlinkends();
+		// Builds mReverseOffsets/mReverseLinks if they aren't yet; mFlowMutex must be held.
+		void buildreverselinks()const;
+		static constexpr int MaxNodeLinks = 24;
+		// Writes the open links of node (x, y) to out in generation order and returns their count:
+		// neighbours up to two cells away whose three capsule rays are clear. With 'dirty' set, only
+		// capsules whose bounds touch it are tested and the rest keep their state from 'current'.
+		int linknode(int x, int y, const ObstructionTest& fnObstructed, const ClearanceTest& fnClearance, float capsuleWidth, nodelink* out, const core::rect* dirty = nullptr, std::span<const nodelink> current = {})const;
 	public:
 		navmesh2d(int width, int height, float worldWidth, float worldHeight);
+		navmesh2d(const navmesh2d&) = delete;
+		navmesh2d& operator=(const navmesh2d&) = delete;
 
 		int width()const { return mWidth; }
 		int height()const { return mHeight; }
+		float cellwidth()const { return mCellWidth; }
+		float cellheight()const { return mCellHeight; }
 
 		const node& get(int x, int y)const;
 		node& get(int x, int y);
 		const node& getworld(float wx, float wy)const;
+		const node& get(int index)const { return mGraph[index]; }
+		// Node index of the cell containing a world position, or -1 outside the grid.
+		int indexat(float wx, float wy)const {
+			int x = worldxtocell(wx), y = worldytocell(wy);
+			return (x < 0 || y < 0 || x >= mWidth || y >= mHeight) ? -1 : y * mWidth + x;
+		}
+		std::span<const nodelink> links(const node& n)const {
+			return mLinksView.subspan(mOffsetsView[n.index], mLinkEnds[n.index] - mOffsetsView[n.index]);
+		}
+		size_t numlinks()const { return mNumLinks; }
+		// Raw CSR arrays as generated. After relink() they can hold unused slots, so only links()
+		// gives a node's current links.
+		std::span<const uint32_t> linkoffsets()const { return mOffsetsView; }
+		std::span<const nodelink> linkarray()const { return mLinksView; }
+		// Uses externally owned CSR arrays instead of generating; storage must outlive the navmesh.
+		// Returns false, leaving the links untouched, unless the arrays form a valid graph over this grid.
+		bool attachlinks(std::span<const uint32_t> offsets, std::span<const nodelink> links);
+
+		static constexpr size_t MaxFlowFields = 8;
+		// Flow field towards a goal node, built on first request and kept for the most recently used goals.
+		// Builds run outside mFlowMutex, so concurrent requests for other goals don't wait on them.
+		std::shared_ptr<const flowfield> flowfieldto(int goal)const;
+		// The kept field towards goal, or nullptr without building one.
+		std::shared_ptr<const flowfield> cachedflowfield(int goal)const;
 
-		int generate(std::function<bool(float, float, float, float)> fnObstructed, float capsuleWidth=1.f);
+		// fnObstructed and fnClearance are called concurrently from the pool's worker threads and
+		// must be thread-safe.
+		int generate(const ObstructionTest& fnObstructed, float capsuleWidth=1.f, const ClearanceTest& fnClearance=nullptr);
+		struct cellrange {
+			int x0, y0, x1, y1;
+			bool empty()const { return x0 > x1 || y0 > y1; }
+		};
+		// Re-tests the links whose capsules touch 'dirty' (world units) after the obstruction under
+		// it changed, with the same test and width generate() used, and returns the inclusive range
+		// of nodes whose links changed. The obstruction may only differ from what generate() saw by
+		// cells that are blocked now. Runs on the calling thread; no queries may run concurrently.
+		cellrange relink(const core::rect& dirty, const ObstructionTest& fnObstructed, float capsuleWidth=1.f, const ClearanceTest& fnClearance=nullptr);
 
+		// A* into a caller-owned context; the returned node indices stay valid until ctx runs another query.
+		std::span<const int> pathfind(navsearch& ctx, float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&, const vector3f&)>& prArrived = nullptr)const;
+		// Same search on the calling thread's navsearch::ThreadInstance().
 		deque<std::pair<float, float>> pathfind(float fromx, float fromy, float tox, float toy, const std::function<bool(const vector3f&, const vector3f&)>& prArrived = nullptr)const;
+
+		// A* towards whichever of several goals is nearest by path, in one search: the heuristic is
+		// the distance to the closest goal and the search ends within pathfind()'s default arrival
+		// distance of any of them. Goals outside the grid are ignored. goalIndex receives the index
+		// of the goal reached, or -1.
+		std::span<const int> pathfindany(navsearch& ctx, float fromx, float fromy, std::span<const vector3f> goals, int* goalIndex = nullptr)const;
+		deque<std::pair<float, float>> pathfindany(float fromx, float fromy, std::span<const vector3f> goals, int* goalIndex = nullptr)const;
+
+		// Bidirectional A* from the start cell to the goal's cell, with 'backward' searching from the
+		// goal over incoming links. Both use the average of the two distance heuristics, which keeps
+		// them consistent, so the result is a shortest path. Gives up as soon as either side runs
+		// out, so an enclosed start or goal costs only the enclosure rather than a flood of the map.
+		// The returned ids stay valid until 'forward' runs another query.
+		std::span<const int> pathfindbidirectional(navsearch& forward, navsearch& backward, float fromx, float fromy, float tox, float toy)const;
+		// Same search with the calling thread's contexts.
+		deque<std::pair<float, float>> pathfindbidirectional(float fromx, float fromy, float tox, float toy)const;
 	};
 }
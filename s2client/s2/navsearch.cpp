@@ -0,0 +1,98 @@
+#include "navsearch.hpp"
+
+namespace s2 {
+	void navsearch::begin(size_t numNodes) {
+		if (mNodes.size() != numNodes) {
+			mNodes.assign(numNodes, nodestate{ .generation = 0 });
+			mGeneration = 0;
+		}
+		// Stamps from 2^32 queries ago would look current again; wipe them once per wraparound.
+		if (++mGeneration == 0) {
+			for (auto& s : mNodes)
+				s.generation = 0;
+			mGeneration = 1;
+		}
+		mHeap.clear();
+	}
+
+	void navsearch::siftup(int pos) {
+		int n = mHeap[pos];
+		float f = mNodes[n].f;
+		while (pos > 0) {
+			int parent = (pos - 1) / 2;
+			int pn = mHeap[parent];
+			if (mNodes[pn].f <= f)
+				break;
+			mHeap[pos] = pn;
+			mNodes[pn].heapIndex = pos;
+			pos = parent;
+		}
+		mHeap[pos] = n;
+		mNodes[n].heapIndex = pos;
+	}
+
+	void navsearch::siftdown(int pos) {
+		int size = int(mHeap.size());
+		int n = mHeap[pos];
+		float f = mNodes[n].f;
+		while (true) {
+			int child = pos * 2 + 1;
+			if (child >= size)
+				break;
+			if (child + 1 < size && mNodes[mHeap[child + 1]].f < mNodes[mHeap[child]].f)
+				child++;
+			int cn = mHeap[child];
+			if (f <= mNodes[cn].f)
+				break;
+			mHeap[pos] = cn;
+			mNodes[cn].heapIndex = pos;
+			pos = child;
+		}
+		mHeap[pos] = n;
+		mNodes[n].heapIndex = pos;
+	}
+
+	bool navsearch::relax(int n, int from, float g, float f) {
+		auto& s = touch(n);
+		if (s.heapIndex == Closed || g >= s.g)
+			return false;
+		s.g = g;
+		s.f = f;
+		s.cameFrom = from;
+		if (s.heapIndex == Unqueued) {
+			mHeap.push_back(n);
+			siftup(int(mHeap.size()) - 1);
+		}
+		else {
+			siftup(s.heapIndex);
+		}
+		return true;
+	}
+
+	int navsearch::pop() {
+		int top = mHeap.front();
+		int last = mHeap.back();
+		mHeap.pop_back();
+		if (!mHeap.empty()) {
+			mHeap[0] = last;
+			siftdown(0);
+		}
+		mNodes[top].heapIndex = Closed;
+		return top;
+	}
+
+	const vector<int>& navsearch::reconstruct(int goal) {
+		mPath.clear();
+		for (int n = goal; n >= 0; n = mNodes[n].cameFrom)
+			mPath.push_back(n);
+		std::reverse(mPath.begin(), mPath.end());
+		return mPath;
+	}
+
+	const vector<int>& navsearch::reconstruct(int meet, const navsearch& backward) {
+		reconstruct(meet);
+		for (int n = backward.mNodes[meet].cameFrom; n >= 0; n = backward.mNodes[n].cameFrom)
+			mPath.push_back(n);
+		return mPath;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+
+namespace s2 {
+	// Reusable A* state for graphs with dense integer node ids, such as navmesh2d::node::index.
+	// Per-node scores live in one flat array stamped with a query generation, so starting a new
+	// query is O(1) instead of clearing. The open set is an indexed binary heap with decrease-key,
+	// so every node is queued at most once. Not thread-safe; use one context per thread.
+	class navsearch {
+		struct nodestate {
+			float g;
+			float f;
+			int cameFrom;
+			// Position in mHeap, or Unqueued / Closed.
+			int heapIndex;
+			uint32_t generation;
+		};
+		static constexpr int Unqueued = -1;
+		static constexpr int Closed = -2;
+
+		vector<nodestate> mNodes;
+		vector<int> mHeap;
+		vector<int> mPath;
+		uint32_t mGeneration = 0;
+
+		nodestate& touch(int n) {
+			auto& s = mNodes[n];
+			if (s.generation != mGeneration)
+				s = nodestate{ .g = std::numeric_limits<float>::infinity(), .f = 0.f, .cameFrom = -1, .heapIndex = Unqueued, .generation = mGeneration };
+			return s;
+		}
+		void siftup(int pos);
+		void siftdown(int pos);
+	public:
+		// Starts a new query over a graph of numNodes nodes.
+		void begin(size_t numNodes);
+
+		float gscore(int n)const {
+			auto& s = mNodes[n];
+			return s.generation == mGeneration ? s.g : std::numeric_limits<float>::infinity();
+		}
+		bool closed(int n)const {
+			auto& s = mNodes[n];
+			return s.generation == mGeneration && s.heapIndex == Closed;
+		}
+
+		// Queues n with cost g and priority f, or lowers its key if g improves on the queued cost.
+		// Closed nodes are left alone, which is exact for consistent heuristics.
+		bool relax(int n, int from, float g, float f);
+		bool empty()const { return mHeap.empty(); }
+		// Lowest queued f; the queue must not be empty.
+		float topf()const { return mNodes[mHeap.front()].f; }
+		// Removes and closes the node with the lowest f.
+		int pop();
+
+		// Path from the query's source to goal as node ids, in a buffer reused across queries.
+		const vector<int>& reconstruct(int goal);
+		// Path from this query's source to meet, continued along 'backward' (a search from the goal
+		// over incoming links) to its source.
+		const vector<int>& reconstruct(int meet, const navsearch& backward);
+
+		static navsearch& ThreadInstance() {
+			thread_local navsearch _Instance;
+			return _Instance;
+		}
+	};
+}
@@ -6,15 +6,119 @@
 using core::random;
 
 namespace s2 {
-	packet netclient::newframe(uint32_t seq, uint8_t flags) {
-		packet frame;
-		frame.writedword(seq);
-		frame.writebyte(1 | flags);
-		frame.writeword(mClientId);
-		return frame;
+	int netclient::enqueue(packet&& body, uint32_t seq, uint8_t flags, int cmdid) {
+		// Frame header and command byte go into the body's headroom, so the body isn't copied.
+		uint8_t header[8];
+		uint16_t clientid = static_cast<uint16_t>(mClientId);
+		memcpy(header, &seq, 4);
+		header[4] = 1 | flags;
+		memcpy(header + 5, &clientid, 2);
+		size_t length = 7;
+		if (cmdid >= 0)
+			header[length++] = static_cast<uint8_t>(cmdid);
+		body.prepend(header, length);
+		int total = static_cast<int>(body.length());
+		if (!(flags & netmsg::FLG_RELIABLE))
+			queue(std::move(body));
+		else if (seq - mSendBase < SendWindow)
+			transmit(seq, std::move(body));
+		else
+			mSendBacklog.emplace_back(seq, std::move(body));
+		return total;
+	}
+
+	void netclient::transmit(uint32_t seq, packet&& frame) {
+		auto& slot = mWindow[seq % SendWindow];
+		assert(!slot.inuse);
+		slot.frame = frame.slice(0, frame.length());
+		slot.seq = seq;
+		slot.inuse = true;
+		slot.retransmits = 0;
+		slot.sentAt = std::chrono::steady_clock::now();
+		mReliableSent++;
+		queue(std::move(frame));
+	}
+
+	void netclient::onack(uint32_t seq) {
+		if (seq - mSendBase >= SendWindow)
+			return;
+		auto& slot = mWindow[seq % SendWindow];
+		if (!slot.inuse || slot.seq != seq)
+			return;
+		// Karn: a retransmitted frame's ack can't tell which copy it answers, so no sample.
+		if (slot.retransmits == 0) {
+			float r = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - slot.sentAt).count();
+			if (mSrtt == 0.f) {
+				mSrtt = r;
+				mRttvar = r / 2.f;
+			}
+			else {
+				mRttvar = 0.75f * mRttvar + 0.25f * fabsf(mSrtt - r);
+				mSrtt = 0.875f * mSrtt + 0.125f * r;
+			}
+			auto rto = milliseconds(static_cast<int64_t>(ceilf(mSrtt + max(1.f, 4.f * mRttvar))));
+			mRto = std::clamp(rto, MinRto, MaxRto);
+		}
+		slot = outstanding();
+		mAcked++;
+
+		// Slide past acked frames, but not past a numbered frame still in the backlog.
+		uint32_t limit = mSendBacklog.empty() ? mSeqNo : mSendBacklog.front().first;
+		while (mSendBase != limit && !mWindow[mSendBase % SendWindow].inuse)
+			mSendBase++;
+		while (!mSendBacklog.empty() && mSendBacklog.front().first - mSendBase < SendWindow) {
+			auto [next, frame] = std::move(mSendBacklog.front());
+			mSendBacklog.pop_front();
+			transmit(next, std::move(frame));
+		}
+	}
+
+	void netclient::retransmitexpired() {
+		auto now = std::chrono::steady_clock::now();
+		for (auto& slot : mWindow) {
+			if (!slot.inuse)
+				continue;
+			// Exponential backoff per frame, capped like the RTO itself.
+			auto timeout = min(mRto * (1 << min(slot.retransmits, 6)), MaxRto);
+			if (now - slot.sentAt < timeout)
+				continue;
+			queue(slot.frame.slice(0, slot.frame.length()));
+			slot.retransmits++;
+			slot.sentAt = now;
+			mRetransmits++;
+		}
+	}
+
+	int netclient::flush() {
+		retransmitexpired();
+		publishstats();
+		return udpclient::flush();
+	}
+
+	void netclient::publishstats() {
+		reliablestats s{
+			.srttMs = mSrtt,
+			.rttvarMs = mRttvar,
+			.rtoMs = float(mRto.count()),
+			.sent = mReliableSent,
+			.acked = mAcked,
+			.retransmits = mRetransmits,
+			.backlog = int(mSendBacklog.size()),
+			.window = SendWindow
+		};
+		for (auto& slot : mWindow)
+			s.inflight += slot.inuse ? 1 : 0;
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		mStats = s;
+	}
+
+	reliablestats netclient::reliability() const {
+		std::lock_guard<std::mutex> lock(mStatsMutex);
+		return mStats;
 	}
 	netclient::netclient(const char* hostname, int port)
 		: udpclient(hostname, port) {
+		attach(network::reactor::Instance());
 		reset();
 	}
 
@@ -27,6 +131,14 @@ namespace s2 {
 		mSeqNo = 1;
 		mExpectedSeq = 1;
 		mQueuedSeqs.clear();
+		for (auto& slot : mWindow)
+			slot = outstanding();
+		mSendBase = mSeqNo;
+		mSendBacklog.clear();
+		mSrtt = mRttvar = 0.f;
+		mRto = InitialRto;
+		mReliableSent = mAcked = mRetransmits = 0;
+		publishstats();
 	}
 	bool netclient::readmsg(netmsg* result) {
 		if (!mQueuedSeqs.empty() && mQueuedSeqs.begin()->seq() == mExpectedSeq) {
@@ -59,6 +171,8 @@ namespace s2 {
 				}
 			}
 			else if (msg.ack()) {
+				if (msg.data().remaining() >= sizeof(uint32_t))
+					onack(msg.data().readdword());
 				return isreadpending() ? readmsg(result) : false;
 			}
 			*result = std::move(msg);
@@ -68,25 +182,17 @@ namespace s2 {
 		return false;
 	}
 	int netclient::sendunreliable(uint8_t cmdid, packet&& data) {
-		packet pkt(newframe(consts::SeqUnreliable));
-		pkt.writebyte(cmdid);
-		pkt.write(data.data(), data.length());
-		return send(pkt);
+		return enqueue(std::move(data), consts::SeqUnreliable, 0, cmdid);
 	}
 	int netclient::sendreliable(uint8_t cmdid, packet&& data) {
-		packet pkt(newframe(mSeqNo++, netmsg::FLG_RELIABLE));
-		pkt.writebyte(cmdid);
-		pkt.write(data.data(), data.length());
-		return send(pkt);
+		return enqueue(std::move(data), mSeqNo++, netmsg::FLG_RELIABLE, cmdid);
 	}
 	int netclient::sendreliable(uint8_t cmdid) {
-		packet pkt(newframe(mSeqNo++, netmsg::FLG_RELIABLE));
-		pkt.writebyte(cmdid);
-		return send(pkt);
+		return enqueue(packet(), mSeqNo++, netmsg::FLG_RELIABLE, cmdid);
 	}
 	int netclient::sendack(uint32_t seqno) {
-		packet pkt(newframe(consts::SeqUnreliable, netmsg::FLG_ACK));
+		packet pkt;
 		pkt.writedword(seqno);
-		return send(pkt);
+		return enqueue(std::move(pkt), consts::SeqUnreliable, netmsg::FLG_ACK);
 	}
 }
@@ -4,9 +4,25 @@
 #include <network/network.hpp>
 #include <network/udpclient.hpp>
 #include <s2/netmsg.hpp>
+#include <mutex>
 using network::packet;
 
 namespace s2 {
+	// State of a netclient's reliable channel. Times are in milliseconds; srtt and rttvar stay 0
+	// until the first ack of a frame that wasn't retransmitted.
+	struct reliablestats {
+		float srttMs = 0.f;
+		float rttvarMs = 0.f;
+		float rtoMs = 0.f;
+		uint64_t sent = 0;
+		uint64_t acked = 0;
+		uint64_t retransmits = 0;
+		// Frames in the send window awaiting an ack, and frames waiting for room in it.
+		int inflight = 0;
+		int backlog = 0;
+		int window = 0;
+	};
+
 	class netclient : protected network::udpclient {
 	private:
 		uint32_t mSeqNo;
@@ -15,10 +31,53 @@ namespace s2 {
 		packet mRecvData;
 		set<netmsg> mQueuedSeqs;
 
-		packet newframe(uint32_t seq, uint8_t flags=0);
+		// Unacked reliable frames live in slot seq % SendWindow, so an ack finds and frees its
+		// frame in O(1). Each keeps a slice of the sent frame for retransmission.
+		static constexpr int SendWindow = 64;
+		static constexpr milliseconds InitialRto = milliseconds(1000);
+		static constexpr milliseconds MinRto = milliseconds(200);
+		static constexpr milliseconds MaxRto = milliseconds(8000);
+		struct outstanding {
+			packet frame;
+			uint32_t seq = 0;
+			bool inuse = false;
+			int retransmits = 0;
+			std::chrono::steady_clock::time_point sentAt;
+		};
+		array<outstanding, SendWindow> mWindow;
+		// Oldest reliable seq that may be unacked; the window covers [mSendBase, mSendBase + SendWindow).
+		uint32_t mSendBase;
+		// Numbered frames past the end of the window, sent as it slides.
+		deque<std::pair<uint32_t, packet>> mSendBacklog;
+		// Smoothed RTT estimate (RFC 6298), in milliseconds.
+		float mSrtt, mRttvar;
+		milliseconds mRto;
+		uint64_t mReliableSent, mAcked, mRetransmits;
+		// Copy of the state above for reliability(), which the UI thread calls while this one sends
+		// and acks. Refreshed by flush() and reset().
+		mutable std::mutex mStatsMutex;
+		reliablestats mStats;
+
+		// Prepends the frame header (and cmdid unless negative) to body and queues it.
+		int enqueue(packet&& body, uint32_t seq, uint8_t flags, int cmdid=-1);
+		// Queues a reliable frame and tracks it in its window slot.
+		void transmit(uint32_t seq, packet&& frame);
+		void onack(uint32_t seq);
+		// Requeues every frame whose backed-off RTO has run out.
+		void retransmitexpired();
+		void publishstats();
 	public:
+		// The socket is served by network::reactor::Instance(), like every other client's.
 		netclient(const char* hostname, int port);
 
+		using network::udpclient::wake;
+		// The send* calls below only queue their frame; flush() retransmits what has timed out
+		// and sends everything queued.
+		int flush();
+		using network::udpclient::stats;
+		// Safe to call from other threads; reflects the channel as of the last flush().
+		reliablestats reliability()const;
+
 		uint32_t clientid()const;
 
 		void reset();
@@ -3,11 +3,13 @@
 namespace s2 {
 	netmsg netmsg::parse(packet& pkt) {
 		netmsg m;
-		m.mSeq = pkt.readdword();
-		m.mFlags = pkt.readbyte();
-		m.mSenderId = pkt.readword();
-		m.mData.resize(pkt.remaining());
-		pkt.read(m.mData.data(), pkt.remaining());
+		auto header = pkt.view();
+		m.mSeq = header.readdword();
+		m.mFlags = header.readbyte();
+		m.mSenderId = header.readword();
+		// The payload shares the datagram's buffer.
+		m.mData = pkt.slice(header.tell(), header.remaining());
+		pkt.seek(pkt.length());
 		return m;
 	}
 	bool netmsg::operator<(const netmsg& o) const noexcept {
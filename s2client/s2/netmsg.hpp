@@ -23,6 +23,7 @@ namespace s2 {
 
 		netmsg(netmsg&& other) noexcept = default;
 		netmsg& operator=(netmsg&& other) noexcept = default;
+		// Consumes the rest of pkt; data() shares its buffer rather than copying the payload.
 		static netmsg parse(packet& pkt);
 
 		bool operator<(const netmsg& o)const noexcept;
@@ -0,0 +1,93 @@
+#include "pathcache.hpp"
+
+namespace s2 {
+	pathcache::pathcache(size_t capacity) : mCapacity(max(size_t(1), capacity)) {
+	}
+
+	uint64_t pathcache::pack(const key& k) {
+		assert(k.src < (1 << 24) && k.goal < (1 << 24) && k.radius < (1 << 14) && k.mode < 4);
+		return (uint64_t(k.src) << 40) | (uint64_t(k.goal) << 16) | (uint64_t(k.radius) << 2) | uint64_t(k.mode);
+	}
+
+	bool pathcache::find(const key& k, deque<vector3f>& path, int& numRefined) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto it = mIndex.find(pack(k));
+		if (it != mIndex.end()) {
+			mEntries.splice(mEntries.begin(), mEntries, it->second);
+			path = it->second->path;
+			numRefined = it->second->numRefined;
+			mStats.hits++;
+			return true;
+		}
+		for (auto e = mEntries.begin(); e != mEntries.end(); ++e) {
+			if (e->k.goal != k.goal || e->k.radius != k.radius || e->k.mode != k.mode)
+				continue;
+			auto cell = std::find(e->cells.begin(), e->cells.end(), k.src);
+			if (cell == e->cells.end())
+				continue;
+			int offset = int(cell - e->cells.begin());
+			// A tail that starts on a coarse hierarchical waypoint would need refining straight away.
+			bool complete = e->numRefined == int(e->cells.size());
+			if (!complete && e->numRefined - offset < 2)
+				continue;
+			path.assign(e->path.begin() + offset, e->path.end());
+			numRefined = e->numRefined - offset;
+			mEntries.splice(mEntries.begin(), mEntries, e);
+			mStats.suffixhits++;
+			return true;
+		}
+		mStats.misses++;
+		return false;
+	}
+
+	void pathcache::insert(const key& k, const deque<vector3f>& path, vector<int> cells, int numRefined) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto packed = pack(k);
+		auto it = mIndex.find(packed);
+		if (it != mIndex.end()) {
+			mEntries.erase(it->second);
+			mIndex.erase(it);
+		}
+		mEntries.push_front(entry{ .k = k, .path = path, .cells = std::move(cells), .numRefined = numRefined });
+		mIndex[packed] = mEntries.begin();
+		while (mEntries.size() > mCapacity) {
+			mIndex.erase(pack(mEntries.back().k));
+			mEntries.pop_back();
+			mStats.evictions++;
+		}
+	}
+
+	void pathcache::clear() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		mEntries.clear();
+		mIndex.clear();
+	}
+
+	size_t pathcache::invalidate(const core::rect& area, bool dropUnreachable) {
+		auto touches = [&](const vector3f& a, const vector3f& b) {
+			return max(a.x, b.x) >= area.x && min(a.x, b.x) <= area.x + area.w
+				&& max(a.y, b.y) >= area.y && min(a.y, b.y) <= area.y + area.h;
+		};
+		std::lock_guard<std::mutex> lock(mMutex);
+		size_t dropped = 0;
+		for (auto e = mEntries.begin(); e != mEntries.end(); ) {
+			bool drop = e->path.empty() ? dropUnreachable : touches(e->path.front(), e->path.front());
+			for (size_t i = 1; i < e->path.size() && !drop; i++)
+				drop = touches(e->path[i - 1], e->path[i]);
+			if (drop) {
+				mIndex.erase(pack(e->k));
+				e = mEntries.erase(e);
+				dropped++;
+			}
+			else {
+				++e;
+			}
+		}
+		return dropped;
+	}
+
+	pathcache::stats pathcache::counters() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mStats;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <core/prerequisites.hpp>
+#include <core/math/vector3.hpp>
+#include <core/utils/quadtree.hpp>
+#include <unordered_map>
+#include <list>
+#include <mutex>
+
+namespace s2 {
+	// LRU cache of recent routes keyed by (source cell, goal cell, arrival radius bucket, mode).
+	// A miss can still be answered from a cached route to the same goal that passes through
+	// the source cell, since the rest of a shortest path is itself a shortest path.
+	// All methods lock, so one cache can serve concurrent pathfind_batch workers.
+	class pathcache {
+	public:
+		static constexpr size_t DefaultCapacity = 256;
+		struct key {
+			int src;
+			int goal;
+			int radius;
+			// Flat and hierarchical results differ in how much of the route is grid-accurate.
+			int mode;
+		};
+		struct stats {
+			uint64_t hits = 0;
+			uint64_t suffixhits = 0;
+			uint64_t misses = 0;
+			uint64_t evictions = 0;
+		};
+	private:
+		struct entry {
+			key k;
+			deque<vector3f> path;
+			// Navmesh node index of every waypoint, for suffix lookups.
+			vector<int> cells;
+			int numRefined;
+		};
+		size_t mCapacity;
+		// Most recently used first.
+		std::list<entry> mEntries;
+		unordered_map<uint64_t, std::list<entry>::iterator> mIndex;
+		stats mStats;
+		mutable std::mutex mMutex;
+
+		static uint64_t pack(const key& k);
+	public:
+		pathcache(size_t capacity = DefaultCapacity);
+
+		// On a hit, path receives the cached route (or its tail from k.src) and numRefined the
+		// number of leading grid-accurate waypoints in it.
+		bool find(const key& k, deque<vector3f>& path, int& numRefined);
+		void insert(const key& k, const deque<vector3f>& path, vector<int> cells, int numRefined);
+		void clear();
+		// Drops every route with a waypoint or a segment's bounds inside the world-space area, and
+		// with dropUnreachable also every cached failure, since opening the area may connect them.
+		// Returns the number of entries dropped.
+		size_t invalidate(const core::rect& area, bool dropUnreachable);
+		stats counters()const;
+	};
+}
@@ -59,6 +59,34 @@ namespace s2 {
 
 		return true;
 	}
+	bool resourcemanager::LoadEntity(core::zipfile& resources, string_view filename) {
+		auto entdata = resources.file(filename);
+		if (!entdata) {
+			core::warning("Failed to load entity from %s\n", filename);
+			return false;
+		}
+
+		tinyxml2::XMLDocument doc;
+		auto err = doc.Parse((const char*)entdata->data(), entdata->length());
+		if (err != tinyxml2::XML_SUCCESS) {
+			core::warning("Failed to parse entity xml in %s.\n   Error: %s\n", filename, doc.ErrorStr());
+			return false;
+		}
+
+		// The root element names the entity kind (building, unit, ...) and carries its type name
+		// and model; definitions without a model, such as gadgets and states, are skipped.
+		auto eroot = doc.RootElement();
+		const char* xmlname;
+		const char* xmlmdf;
+		if (!eroot || tinyxml2::XML_SUCCESS != eroot->QueryStringAttribute("name", &xmlname)
+			|| tinyxml2::XML_SUCCESS != eroot->QueryStringAttribute("model", &xmlmdf))
+			return false;
+		if (xmlmdf[0] == '/')
+			mEntityModels[xmlname] = xmlmdf;
+		else
+			mEntityModels[xmlname] = '/' + string(filename.substr(0, filename.find_last_of('/') + 1)) + xmlmdf;
+		return true;
+	}
 	resourcemanager::~resourcemanager() {
 		mModels.clear();
 	}
@@ -71,14 +99,23 @@ namespace s2 {
 				if (LoadMdf(resources, name))
 					core::info("Loaded %s successfully.\n", name);
 			}
+			else if (name.ends_with(".entity")) {
+				LoadEntity(resources, name);
+			}
 		}
 		return true;
 	}
-	const std::shared_ptr<model> resourcemanager::LookupModel(string mdf) const {
+	const std::shared_ptr<model> resourcemanager::LookupModel(string_view mdf) const {
 		auto it = mModels.find(mdf);
 		if (it == mModels.end())
 			return nullptr;
 		else
 			return it->second;
 	}
+	const std::shared_ptr<model> resourcemanager::LookupEntityModel(string_view entityname) const {
+		auto it = mEntityModels.find(entityname);
+		if (it == mEntityModels.end())
+			return nullptr;
+		return LookupModel(it->second);
+	}
 }
@@ -6,8 +6,12 @@
 
 namespace s2 {
 	class resourcemanager {
-		map<string, std::shared_ptr<model>> mModels;
+		// Transparent comparator, so lookups by string_view don't build a string.
+		map<string, std::shared_ptr<model>, std::less<>> mModels;
+		// Model (.mdf) path of each entity definition, by entity type name.
+		map<string, string, std::less<>> mEntityModels;
 		bool LoadMdf(core::zipfile& resources, string_view filename);
+		bool LoadEntity(core::zipfile& resources, string_view filename);
 		static resourcemanager _Instance;
 	public:
 		static resourcemanager* Instance() {
@@ -19,8 +23,9 @@ namespace s2 {
 
 		bool LoadResources(core::zipfile& resources);
 
-		const std::shared_ptr<model> LookupModel(string mdf)const;
-		const std::shared_ptr<model> LookupModel(string_view mdf)const { return LookupModel(string(mdf)); }
+		const std::shared_ptr<model> LookupModel(string_view mdf)const;
+		// Model of the entity type defined with this name in a .entity file, e.g. "Building_Garrison".
+		const std::shared_ptr<model> LookupEntityModel(string_view entityname)const;
 	};
 
 	extern resourcemanager* gResourceManager;
@@ -8,6 +8,7 @@
 #include <core/io/logger.hpp>
 #include <core/utils/random.hpp>
 #include <core/math/vector3.hpp>
+#include <core/math/mat4.hpp>
 #include <ext/miniz/miniz.h>
 
 #include <sstream>
@@ -34,16 +35,33 @@ namespace s2 {
 		mSvState.clear();
 		mStateFragments.clear();
 		mSnapshotFragments.clear();
+		mPendingBuildings.clear();
 		resetlocalent();
 	}
 	void userclient::resetlocalent() {
 		mWaypoints.clear();
+		stopflowing();
+		mFlowRequest = -1;
+		mHasPath = false;
 		mClientState.clearinput();
 	}
 	userclient::userclient(uint32_t accountid)
 		: mNet(nullptr), mAccountId(accountid) {
 		reset();
 	}
+	userclient::~userclient() {
+		canceltimers();
+	}
+
+	void userclient::canceltimers() {
+		// Once cancel returns the callback isn't running, so mNet can go away after this.
+		auto& reactor = network::reactor::Instance();
+		if (mSnapshotTimer)
+			reactor.cancel(mSnapshotTimer);
+		if (mConnectTimer)
+			reactor.cancel(mConnectTimer);
+		mSnapshotTimer = mConnectTimer = 0;
+	}
 
 	const std::shared_ptr<world> userclient::currentworld() const {
 		return mGame.currentworld();
@@ -78,6 +96,14 @@ namespace s2 {
 		return mRecvdSnapshots;
 	}
 
+	network::iostats userclient::iostats() const {
+		return mNet ? mNet->stats() : network::iostats{};
+	}
+
+	reliablestats userclient::reliability() const {
+		return mNet ? mNet->reliability() : reliablestats{};
+	}
+
 	string_view userclient::cvar(string_view key) {
 		return mCvars[key.data()];
 	}
@@ -89,7 +115,15 @@ namespace s2 {
 		reset();
         mHostname = ip;
         mPort = port;
+		canceltimers();
 		mNet = std::make_unique<netclient>(ip.data(), port);
+		auto& reactor = network::reactor::Instance();
+		auto interval = milliseconds(1000 / mPacketSendFps);
+		mSnapshotDue = false;
+		mSnapshotTimer = reactor.schedule(interval, [this] {
+			mSnapshotDue = true;
+			mNet->wake();
+		}, interval);
 
 		packet pkt;
 		pkt.writestring(consts::ConnectMagic);
@@ -100,16 +134,24 @@ namespace s2 {
 		pkt.writedword(mAccountId);
 		pkt.writestring(""); // ?
 
-		int nbsent = mNet->sendunreliable(ClientCmd::Connect, std::move(pkt));
-		if (nbsent > 0) {
-			for (int i = 0; i < 10; i++) {
+		mNet->sendunreliable(ClientCmd::Connect, std::move(pkt));
+		if (mNet->flush() >= 0) {
+			// update() blocks until a datagram arrives or a timer wakes it, so this waits for the
+			// reply or the timeout without polling.
+			mConnectTimedOut = false;
+			mConnectTimer = reactor.schedule(ConnectTimeout, [this] {
+				mConnectTimedOut = true;
+				mNet->wake();
+			});
+			while (!mConnectTimedOut) {
 				if (update() > 0) {
 					//mState = Connecting;
 					//mConnected = true;
 					break;
 				}
-				Sleep(100);
 			}
+			reactor.cancel(mConnectTimer);
+			mConnectTimer = 0;
 		}
 		else {
 			mConnected = false;
@@ -122,13 +164,13 @@ namespace s2 {
 		packet pkt;
 		pkt.writestring(reason);
 		mNet->sendreliable(ClientCmd::Disconnect, std::move(pkt));
+		mNet->flush();
 		reset();
 		mState = Disconnected;
 		mConnected = false;
 	}
 
 	int userclient::update() {
-		auto now = std::chrono::high_resolution_clock::now();
 		netmsg m;
 		int count = 0;
 		if (mNet->readmsg(&m)) {
@@ -139,16 +181,15 @@ namespace s2 {
 				count++;
 			}
 		}
-		if (mIngame) {
-			auto mselapsed = MsDuration(now - mLastClientSnapshot).count();
+		if (mSnapshotDue.exchange(false) && mIngame) {
 			auto cli = clientinfo();
-			int ping = cli.ping;
-			if (mselapsed >= (1000 / mPacketSendFps)) {
-				sendclientsnapshot(ping);
-			}
+			sendclientsnapshot(cli.ping);
 		}
 
 		think();
+		mHasPath = !mWaypoints.empty() || mFlowTargetId >= 0;
+		// Everything this tick queued (acks, snapshot, requests) goes out in one batch.
+		mNet->flush();
 		return count;
 	}
 
@@ -167,11 +208,13 @@ namespace s2 {
 				teamrequest(2);
 				teamrequest(1);
 				mState = Spawning;
-				Sleep(100);
+				mSpawnRequestAt = std::chrono::steady_clock::now() + SpawnRequestDelay;
 			}
 		} break;
 		case Spawning:
 		{
+			if (std::chrono::steady_clock::now() < mSpawnRequestAt)
+				return;
 			auto info = clientinfo();
 			auto local = getent(mGame.clientinfo().playerEntityIndex);
 			if (!local || local->dormant()) {
@@ -212,6 +255,67 @@ namespace s2 {
 				if (pos.lengthsq() < 1.f) {
 					return;
 				}
+				int requested = mFlowRequest.exchange(-1);
+				if (requested >= 0 && getent(requested)) {
+					mWaypoints.clear();
+					mFlowTargetId = requested;
+					mTargetSize = mFlowRequestSize;
+					mFlowField = nullptr;
+				}
+				if (mFlowTargetId >= 0) {
+					auto goal = getent(mFlowTargetId);
+					if (!goal) {
+						stopflowing();
+						mClientState.clearinput();
+						return;
+					}
+					mPathTarget = goal->m_v3Position;
+					auto delta = mPathTarget - pos;
+					delta.z = 0.f;
+					if (delta.length() < mTargetSize) {
+						stopflowing();
+						mClientState.clearinput();
+						return;
+					}
+					// Fields are cached per goal cell. A missing one (the goal moved to another cell, or a
+					// blocker dropped the cache) takes tens of milliseconds to build, so that happens on
+					// its own thread while the previous field keeps steering. A build started for another cell
+					// says nothing about this one and mustn't hold up its build.
+					int goalcell = currentworld()->navcell(mPathTarget);
+					if (mFlowBuild.valid() && mFlowBuildGoal != goalcell)
+						mStaleFlowBuilds.push_back(std::move(mFlowBuild));
+					std::erase_if(mStaleFlowBuilds, [](const std::future<bool>& f) { return f.wait_for(milliseconds(0)) == std::future_status::ready; });
+					bool offmesh = false;
+					if (mFlowBuild.valid() && mFlowBuild.wait_for(milliseconds(0)) == std::future_status::ready)
+						offmesh = !mFlowBuild.get();
+					if (auto field = currentworld()->cachedflowfield(mPathTarget)) {
+						mFlowField = field;
+					}
+					else if (offmesh) {
+						// The goal is off the navmesh.
+						stopflowing();
+						pathtowards(mPathTarget, mTargetSize);
+						return;
+					}
+					else if (!mFlowBuild.valid()) {
+						mFlowBuildGoal = goalcell;
+						mFlowBuild = std::async(std::launch::async, [world = currentworld(), goal = mPathTarget] {
+							return world->flowfieldto(goal) != nullptr;
+						});
+					}
+					if (!mFlowField)
+						return;
+					float nx, ny;
+					if (!mFlowField->waypoint(pos.x, pos.y, FlowLookahead, nx, ny)) {
+						// Standing somewhere the field doesn't reach; fall back to a regular path.
+						stopflowing();
+						pathtowards(mPathTarget, mTargetSize);
+					}
+					else {
+						movetowards(vector3f(nx, ny, currentworld()->terrainheight(nx, ny)));
+					}
+					return;
+				}
 				while (mWaypoints.size() > 1) {
 					auto next = mWaypoints.front();
 					auto n2 = mWaypoints.at(1);
@@ -222,6 +326,7 @@ namespace s2 {
 					if (fromnext.dot(mCurrentPathingDir) >= -5.f) {// || fromnext.lengthsq() < (50.f*50.f)) {
 						//core::info("fromnext %.2f,%.2f,%.2f\n", fromnext.x, fromnext.y, fromnext.z);
 						mWaypoints.pop_front();
+						mRefinedWaypoints--;
 						mCurrentPathingDir = (mWaypoints.front() - next).unit();
 						if (!mWaypoints.empty()) {
 							auto fromnext2 = pos - mWaypoints.front();
@@ -231,6 +336,10 @@ namespace s2 {
 					else
 						break;
 				}
+				// Refine the next stretch before walking onto coarse waypoints.
+				if (mRefinedWaypoints <= 1 && mWaypoints.size() > 1) {
+					pathtowards(mPathTarget, mTargetSize);
+				}
 				if (!mWaypoints.empty()) {
 					auto dst = mWaypoints.back();
 					float distance;
@@ -299,9 +408,9 @@ namespace s2 {
 		auto local = getent(mGame.clientinfo().playerEntityIndex);
 		if (local) {
 			auto pos = local->m_v3Position;
-			mWaypoints = mGame.currentworld()->pathfind(pos, target, [=](const vector3f& from, const vector3f& to) -> bool {
-				return (to - from).lengthsq() < (targetSize * targetSize);
-			});
+			mWaypoints = mGame.currentworld()->cachedpathfind(pos, target, targetSize, pathmode::hierarchical, &mRefinedWaypoints);
+			mGame.currentworld()->smoothpath(mWaypoints, &mRefinedWaypoints);
+			mPathTarget = target;
 			if (!mWaypoints.empty()) {
 				mCurrentPathingDir = (mWaypoints.front() - pos).unit();
 				movetowards(mWaypoints.front());
@@ -310,8 +419,44 @@ namespace s2 {
 		}
 	}
 
+	void userclient::repath() {
+		// Flow fields are looked up again every tick; only a waypoint path needs replanning.
+		if (!mWaypoints.empty() && mFlowTargetId < 0)
+			pathtowards(mPathTarget, mTargetSize);
+	}
+
+	void userclient::stopflowing() {
+		mFlowTargetId = -1;
+		mFlowField = nullptr;
+	}
+
+	void userclient::placebuilding(const entity& building) {
+		auto& pos = building.m_v3Position;
+		float angle = building.m_v3Angles.z;
+		dynamicblocker blocker{ .x = pos.x, .y = pos.y, .halfwidth = BuildingHalfExtent, .halfheight = BuildingHalfExtent, .angle = angle };
+		if (auto model = gResourceManager->LookupEntityModel(building.typname())) {
+			// Models aren't always centred on their origin, so the box centre turns with the building.
+			auto& min = model->BBMin();
+			auto& max = model->BBMax();
+			auto centre = mat4f::zrotation(-angle * float(M_PI) / 180.f) * vector3f((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, 0.f);
+			blocker.x += centre.x;
+			blocker.y += centre.y;
+			blocker.halfwidth = abs(max.x - min.x) * 0.5f;
+			blocker.halfheight = abs(max.y - min.y) * 0.5f;
+		}
+		mGame.currentworld()->setblocker(building.id(), blocker);
+		repath();
+	}
+
+	void userclient::flowtowards(const entity& target, float targetSize) {
+		if (!ingame())
+			return;
+		mFlowRequestSize = targetSize;
+		mFlowRequest = target.id();
+	}
+
 	bool userclient::haspath() const {
-		return !mWaypoints.empty();
+		return mHasPath || mFlowRequest >= 0;
 	}
 
 	const deque<vector3f>& userclient::path() const {
@@ -410,10 +555,8 @@ namespace s2 {
 		mNet->sendreliable(ClientCmd::Gamedata, std::move(pkt));
 	}
 	void userclient::sendgamedata(uint8_t id, packet&& data) {
-		packet pkt;
-		pkt.writebyte(id);
-		pkt.write(data.data(), data.length());
-		mNet->sendreliable(ClientCmd::Gamedata, std::move(pkt));
+		data.prepend(&id, 1);
+		mNet->sendreliable(ClientCmd::Gamedata, std::move(data));
 	}
 
 	void userclient::teamrequest(uint16_t id) {
@@ -487,6 +630,14 @@ namespace s2 {
 		mRecvdSnapshots++;
 		auto hdr = mGame.rcvserversnapshot(pkt, length, m_yStateStringSequence, mLocalClientNumber);
 		mCurrentFrame = hdr.frameId;
+		if (mGame.currentworld()) {
+			std::erase_if(mPendingBuildings, [this](int id) {
+				auto building = getent(id);
+				if (building)
+					placebuilding(*building);
+				return building != nullptr;
+			});
+		}
 		return true;
 	}
 
@@ -699,9 +850,8 @@ namespace s2 {
 		{
 			auto snapshotlen = pkt.readdword();
 			size_t p0 = pkt.tell();
-			packet copy;
-			copy.write(pkt.nextdata(), snapshotlen);
-			processserversnapshot(copy);
+			auto snapshot = pkt.slice(pkt.tell(), snapshotlen);
+			processserversnapshot(snapshot);
 			pkt.advance(snapshotlen);
 			if ((pkt.tell() - p0) != snapshotlen) {
 				core::error("Advanced %d bytes (specified snapshot length was %d bytes)\n", pkt.tell() - p0, snapshotlen);
@@ -851,6 +1001,11 @@ namespace s2 {
 		{
 			auto id = pkt.readword();
 			core::info("Building construction started %d\n", id);
+			auto building = mGame.getent(id);
+			if (building && mGame.currentworld())
+				placebuilding(*building);
+			else
+				mPendingBuildings.insert(id);
 		} break;
 		case Gamedata::GoldmineLow:
 		{
@@ -862,6 +1017,9 @@ namespace s2 {
 			auto id = pkt.readword();
 			auto wot = pkt.readbyte();
 			core::info("Building destroyed %d; %d\n", id, wot);
+			mPendingBuildings.erase(id);
+			if (mGame.currentworld() && mGame.currentworld()->removeblocker(id))
+				repath();
 		} break;
 		case Gamedata::Death:
 		{
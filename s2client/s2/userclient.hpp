@@ -48,6 +48,15 @@ namespace s2 {
 		long mPacketSendFps = 30;
 		bool mConnected = false;
 		bool mIngame = false;
+		// Reactor timers; their callbacks only raise a flag and wake update() on this thread.
+		network::reactor::timerid mSnapshotTimer = 0;
+		network::reactor::timerid mConnectTimer = 0;
+		std::atomic<bool> mSnapshotDue = false;
+		std::atomic<bool> mConnectTimedOut = false;
+		static constexpr milliseconds ConnectTimeout = milliseconds(1000);
+		// Pause between the team requests and the first spawn request.
+		static constexpr milliseconds SpawnRequestDelay = milliseconds(100);
+		std::chrono::steady_clock::time_point mSpawnRequestAt;
 
 		map<int, int> mTeamInfoEnts;
 
@@ -86,14 +95,48 @@ namespace s2 {
 		//map<int, entity> mEntities;
 		clientstate mClientState;
 		deque<vector3f> mWaypoints;
+		// Leading waypoints that follow the grid; the rest are coarse cluster entrances.
+		int mRefinedWaypoints = 0;
+		vector3f mPathTarget;
+		// Entity to steer towards by flow field instead of mWaypoints, or -1.
+		int mFlowTargetId = -1;
+		// Latest flow field towards it; lags a cell behind the goal while mFlowBuild builds the next.
+		std::shared_ptr<const flowfield> mFlowField;
+		// Flow field build running on its own thread; yields whether the goal was on the navmesh.
+		std::future<bool> mFlowBuild;
+		// Navmesh cell mFlowBuild was started for.
+		int mFlowBuildGoal = -1;
+		// Builds for goal cells the target has since left. Dropping a std::async future waits for
+		// it, so they are kept until they finish.
+		vector<std::future<bool>> mStaleFlowBuilds;
+		// Flow target posted by flowtowards() from another thread, or -1; think() picks it up.
+		std::atomic<int> mFlowRequest = -1;
+		std::atomic<float> mFlowRequestSize = 25.f;
+		// Whether think() left a path or flow field to follow, for haspath() on other threads.
+		std::atomic<bool> mHasPath = false;
+		// Cells ahead on the flow field to steer towards, which smooths out the 8-way grid steps.
+		static constexpr int FlowLookahead = 3;
+		// Footprint assumed for buildings whose type has no model bounds in the loaded resources.
+		static constexpr float BuildingHalfExtent = 128.f;
+		// Buildings whose construction started before their entity arrived in a snapshot; they are
+		// stamped into the world once it does.
+		set<int> mPendingBuildings;
 		vector3f mCurrentPathingDir;
 		float mTargetSize;
 
 		void reset();
 		void resetworld();
 		void resetlocalent();
+		void canceltimers();
+		// Plans the current waypoint path again, e.g. after the navmesh changed under it.
+		void repath();
+		// Stops steering by flow field; a build still running finishes on its own.
+		void stopflowing();
+		// Stamps a building's footprint, the x/y bounds of its type's model, into the world.
+		void placebuilding(const entity& building);
 	public:
 		userclient(uint32_t accountid);
+		~userclient();
 
 		const std::shared_ptr<world> currentworld()const;
 
@@ -104,6 +147,8 @@ namespace s2 {
 		uint32_t servertime()const;
 		uint64_t sentsnapshots()const;
 		uint64_t recvdsnapshots()const;
+		network::iostats iostats()const;
+		reliablestats reliability()const;
 
 		string_view cvar(string_view key);
 		void cvar(string_view key, string_view value);
@@ -121,6 +166,9 @@ namespace s2 {
 		const TeamInfo teaminfo(int id)const;
 		void movetowards(const vector3f& target);
 		void pathtowards(const vector3f& target, float targetSize=25.f);
+		// Safe to call from other threads: only posts the target, which the next think() steers by.
+		void flowtowards(const entity& target, float targetSize=25.f);
+		// Safe to call from other threads; a posted flow target counts as a path.
 		bool haspath()const;
 		const deque<vector3f>& path()const;
 
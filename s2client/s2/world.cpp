@@ -5,9 +5,15 @@
 #include <core/math/interp.hpp>
 #include <core/math/mat4.hpp>
 #include <core/io/logger.hpp>
+#include <core/utils/threadpool.hpp>
+#include <core/utils/random.hpp>
 #include <ext/tinyxml2/tinyxml2.h>
 #include <ext/miniz/miniz.h>
 
+#include <filesystem>
+#include <charconv>
+#include <emmintrin.h>
+
 namespace s2 {
 	static bool LoadWorldConfig(worldconfig& config, mz_zip_archive* pArchive) {
 		size_t datalen;
@@ -39,74 +45,169 @@ namespace s2 {
 		return true;
 	}
 
+	namespace {
+		// Attributes of one start tag, as views into the source buffer. Entity references
+		// (&amp; etc.) are left undecoded; entitylist values never use them.
+		struct xmlattrs {
+			static constexpr int MaxAttrs = 16;
+			std::pair<string_view, string_view> attrs[MaxAttrs];
+			int count = 0;
+
+			// Returns a null view if the attribute is missing.
+			string_view get(string_view name)const {
+				for (int i = 0; i < count; i++) {
+					if (attrs[i].first == name)
+						return attrs[i].second;
+				}
+				return {};
+			}
+		};
+
+		bool isxmlspace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+		// Forward-only scan over an XML buffer, calling fn(depth, name, attrs) for every start
+		// tag. Declarations, comments and closing tags are skipped over; text content is ignored.
+		// Returns false if the buffer ends inside a tag.
+		template<typename Fn>
+		bool scanxml(const char* p, const char* end, Fn&& fn) {
+			auto skipspace = [&]() { while (p < end && isxmlspace(*p)) p++; };
+			auto skippast = [&](string_view s) {
+				auto it = std::search(p, end, s.begin(), s.end());
+				p = it == end ? end : it + s.size();
+				return it != end;
+			};
+			int depth = 0;
+			xmlattrs attrs;
+			while ((p = std::find(p, end, '<')) < end) {
+				p++;
+				if (p < end && *p == '?') {
+					if (!skippast("?>")) return false;
+					continue;
+				}
+				if (end - p >= 3 && p[0] == '!' && p[1] == '-' && p[2] == '-') {
+					if (!skippast("-->")) return false;
+					continue;
+				}
+				if (p < end && (*p == '!' || *p == '/')) {
+					if (*p == '/')
+						depth--;
+					if (!skippast(">")) return false;
+					continue;
+				}
+
+				auto namestart = p;
+				while (p < end && !isxmlspace(*p) && *p != '>' && *p != '/')
+					p++;
+				string_view name(namestart, p - namestart);
+				attrs.count = 0;
+				for (;;) {
+					skipspace();
+					if (p >= end)
+						return false;
+					if (*p == '>' || *p == '/')
+						break;
+					auto keystart = p;
+					while (p < end && !isxmlspace(*p) && *p != '=' && *p != '>')
+						p++;
+					string_view key(keystart, p - keystart);
+					skipspace();
+					if (p >= end || *p != '=')
+						return false;
+					p++;
+					skipspace();
+					if (p >= end || (*p != '"' && *p != '\''))
+						return false;
+					char quote = *p++;
+					auto valstart = p;
+					p = std::find(p, end, quote);
+					if (p >= end)
+						return false;
+					if (attrs.count < xmlattrs::MaxAttrs)
+						attrs.attrs[attrs.count++] = { key, string_view(valstart, p - valstart) };
+					p++;
+				}
+				bool selfclosing = *p == '/';
+				if (!skippast(">"))
+					return false;
+				fn(depth, name, attrs);
+				if (!selfclosing)
+					depth++;
+			}
+			return true;
+		}
+
+		// Parses count whitespace separated floats from s. Accepts what std::stof would for the
+		// values found in entitylists (leading whitespace, optional sign, exponent).
+		bool parsefloats(string_view s, float* out, int count) {
+			auto p = s.data(), end = s.data() + s.size();
+			for (int i = 0; i < count; i++) {
+				while (p < end && isxmlspace(*p))
+					p++;
+				if (p < end && *p == '+')
+					p++;
+				auto res = std::from_chars(p, end, out[i]);
+				if (res.ec != std::errc())
+					return false;
+				p = res.ptr;
+			}
+			return true;
+		}
+	}
+
 	static bool LoadProps(vector<worldprop>& props, mz_zip_archive* pArchive) {
 		size_t datalen;
 		const char* entitylist = (const char*)mz_zip_reader_extract_file_to_heap(pArchive, "entitylist", &datalen, 0);
 		if (!entitylist)
 			return false;
 
-		tinyxml2::XMLDocument doc;
-		doc.Parse(entitylist, datalen);
-		auto wel = doc.FirstChildElement("WorldEntityList");
-		for (auto e = wel->FirstChildElement(); e != wel->LastChildElement(); e=e->NextSiblingElement()) {
-			string_view model = e->Attribute("model");
-			if (model.find("/tools/blocker") != string::npos)
-				continue;
-			if (model.find("/nature/waterfall") != string::npos)
-				continue;
-			if (model.find("/rock_arch") != string::npos)
-				continue;
-			if (model.find("/props/natural_bridge") != string::npos)
-				continue;
-			float scale = e->FloatAttribute("scale", 1.0f);
-			string_view type = e->Attribute("type");
-			string spos = e->Attribute("position");
-			string sangles = e->Attribute("angles");
-			vector3f vpos, vangles;
-			{
-				size_t idx = 0, nchars = 0;
-				vpos.x = std::stof(spos, &nchars); idx += nchars;
-				vpos.y = std::stof(spos.substr(idx), &nchars); idx += nchars;
-				vpos.z = std::stof(spos.substr(idx), &nchars);
-			}
-			{
-				size_t idx = 0, nchars = 0;
-				vangles.x = std::stof(sangles, &nchars); idx += nchars;
-				vangles.y = std::stof(sangles.substr(idx), &nchars); idx += nchars;
-				vangles.z = std::stof(sangles.substr(idx), &nchars); idx += nchars;
-			}
-			string modelpath;
-			if (model.find("_arch.mdf") != string::npos) {
-				
-			}
-			if (model.find("/effects/") != string::npos)
-				continue;
-			if (model.ends_with(".mdf"))
-				modelpath = string(model.substr(0, model.size() - 4)) + ".model";
-			else
-				modelpath = model;
-			auto mi = gResourceManager->LookupModel(model);
-			core::info("%s: %s @ %s; angles %s\n", type, model, vpos.str(), vangles.str());
-			static map<string, float> predefinedSz = {
-				{ "/trees/",  5.f },
-				{ "/shrubs/", 5.f },
-				{ "/rocks/",  10.f }
-			};
-			if (mi) {
-				//if (0 == type.compare("Prop_Scenery") || 0 == type.compare("Prop_Mine") || 0 == type.compare("Prop_Scar")) {
-				props.push_back(worldprop{ .modelname = model.data(), .type = string(type), .scale = scale, .pos = vpos, .angles = vangles, .model = mi });
-				auto sz = (mi->BBMax() - mi->BBMin());
-				core::info("Added prop size %fm2\n", (abs(sz.x * sz.y)));
-				//}
+		static constexpr string_view skipped[] = {
+			"/tools/blocker", "/nature/waterfall", "/rock_arch", "/props/natural_bridge", "/effects/"
+		};
+		// Upper bound on the entity count; avoids regrowing the table while parsing.
+		props.reserve(props.size() + std::count(entitylist, entitylist + datalen, '<'));
+
+		bool inlist = false, foundlist = false;
+		size_t numentities = 0, numskipped = 0, nummissing = 0, nummalformed = 0;
+		bool ok = scanxml(entitylist, entitylist + datalen, [&](int depth, string_view name, const xmlattrs& attrs) {
+			if (depth == 0) {
+				inlist = name == "WorldEntityList";
+				foundlist |= inlist;
+				return;
 			}
-			else {
-				for (auto& pd : predefinedSz) {
+			if (depth != 1 || !inlist)
+				return;
 
-				}
+			numentities++;
+			string_view model = attrs.get("model");
+			if (std::any_of(std::begin(skipped), std::end(skipped), [&](string_view s) { return model.find(s) != string_view::npos; })) {
+				numskipped++;
+				return;
 			}
-		}
+			float pos[3], angles[3];
+			if (!model.data() || !parsefloats(attrs.get("position"), pos, 3) || !parsefloats(attrs.get("angles"), angles, 3)) {
+				nummalformed++;
+				return;
+			}
+			float scale = 1.f;
+			if (!parsefloats(attrs.get("scale"), &scale, 1))
+				scale = 1.f;
 
+			auto mi = gResourceManager->LookupModel(model);
+			if (!mi) {
+				nummissing++;
+				return;
+			}
+			props.push_back(worldprop{ .modelname = string(model), .type = string(attrs.get("type")), .scale = scale, .pos = vector3f(pos[0], pos[1], pos[2]), .angles = vector3f(angles[0], angles[1], angles[2]), .model = mi });
+		});
 		free((void*)entitylist);
+
+		if (!ok || !foundlist) {
+			core::warning("Malformed entitylist (%s)\n", ok ? "no WorldEntityList" : "truncated");
+			return false;
+		}
+		if (nummalformed > 0)
+			core::warning("Skipped %zu entities with missing model, position or angles\n", nummalformed);
+		core::info("Loaded %zu props from %zu entities (%zu filtered, %zu without a model)\n", props.size(), numentities, numskipped, nummissing);
 		return true;
 	}
 
@@ -122,18 +223,44 @@ namespace s2 {
 		bool heightbytes = width < 0;
 		if (width < 0)
 			width = -width;
+		size_t count = size_t(width) * height;
+		size_t needed = stream.tell() + count * (heightbytes ? 3 : sizeof(float));
+		if (width <= 0 || height <= 0 || needed > datalen) {
+			core::warning("Truncated %dx%d heightmap.\n", width, height);
+			free(pheightmap);
+			return false;
+		}
 		map.initialize(width, height);
+		float* out = &map[0];
+		const uint8_t* samples = pheightmap + stream.tell();
 		if (heightbytes) {
-			for (int i = 0; i < (width * height); i++)
-				map[i] = stream.readByte() * 0.00390625f;
-			for (int i = 0; i < (width * height); i++)
-				map[i] += float(stream.readByte());
-			for (int i = 0; i < (width * height); i++)
-				map[i] = ((256.f * stream.readByte()) + map[i]) - 32768.f;
+			// Three byte planes (fraction, low, high), combined in one pass with the same float
+			// operations per sample as the reference decode: (256 * high + (low + fraction / 256)) - 32768.
+			const uint8_t* frac = samples;
+			const uint8_t* low = samples + count;
+			const uint8_t* high = samples + 2 * count;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128 scale = _mm_set1_ps(0.00390625f), base = _mm_set1_ps(32768.f), hscale = _mm_set1_ps(256.f);
+			auto widen = [&zero](__m128i bytes, int quarter) {
+				__m128i words = quarter < 2 ? _mm_unpacklo_epi8(bytes, zero) : _mm_unpackhi_epi8(bytes, zero);
+				return _mm_cvtepi32_ps((quarter & 1) ? _mm_unpackhi_epi16(words, zero) : _mm_unpacklo_epi16(words, zero));
+			};
+			size_t i = 0;
+			for (; i + 16 <= count; i += 16) {
+				__m128i f = _mm_loadu_si128((const __m128i*)(frac + i));
+				__m128i l = _mm_loadu_si128((const __m128i*)(low + i));
+				__m128i h = _mm_loadu_si128((const __m128i*)(high + i));
+				for (int q = 0; q < 4; q++) {
+					__m128 v = _mm_add_ps(_mm_mul_ps(widen(f, q), scale), widen(l, q));
+					v = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(hscale, widen(h, q)), v), base);
+					_mm_storeu_ps(out + i + q * 4, v);
+				}
+			}
+			for (; i < count; i++)
+				out[i] = ((256.f * high[i]) + (frac[i] * 0.00390625f + float(low[i]))) - 32768.f;
 		}
 		else {
-			for (int i = 0; i < (width * height); i++)
-				map[i] = stream.readFloat();
+			memcpy(out, samples, count * sizeof(float));
 		}
 
 		free(pheightmap);
@@ -151,8 +278,10 @@ namespace s2 {
 		int width = stream.readInt();
 		int height = stream.readInt();
 		map.initialize(width, height);
-		for (int i = 0; i < (width * height); i++)
-			map[i] = stream.readByte() != 0;
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++)
+				map.set(x, y, stream.readByte() != 0);
+		}
 
 		free(pblockers);
 		core::info("Loaded %dx%d vertex blockers.\n", width, height);
@@ -162,27 +291,69 @@ namespace s2 {
 	void world::generateobstructionmap(float cellsize) {
 		int sz = int(mWorldSize / cellsize);
 		mObstructionMap.initialize(sz, sz);
-		for (int y = 0; y < sz; y++) {
-			for (int x = 0; x < sz; x++) {
-				float wx = x * cellsize + 0.5f * cellsize;
-				float wy = y * cellsize + 0.5f * cellsize;
-				if (isblocked(wx, wy) || terrainslope(wx, wy) > 0.95f || testrectinscenery(x*cellsize, y*cellsize, cellsize, cellsize, 20.f))
-				{
-					mObstructionMap.set(x, y, true);
+
+		// Split the grid into tiles and let the pool hand them out. Each tile runs the three
+		// tests as separate passes (cheapest first), and later passes only look at cells that
+		// are still open, which gives the same result as the short-circuited per-cell test.
+		// Tiles are 64 cells wide so each one owns whole words of the packed map.
+		const int tilewidth = 64, tileheight = 16;
+		int ntilesx = (sz + tilewidth - 1) / tilewidth;
+		int ntiles = ntilesx * ((sz + tileheight - 1) / tileheight);
+		auto& pool = core::threadpool::Instance();
+		struct workertimes {
+			double blockers = 0.0, slope = 0.0, scenery = 0.0;
+		};
+		vector<workertimes> times(pool.size());
+		auto start = high_resolution_clock::now();
+		pool.parallel_for(ntiles, [&](int tile, int worker) {
+			auto& ws = times[worker];
+			int x0 = (tile % ntilesx) * tilewidth, x1 = min(sz, x0 + tilewidth);
+			int y0 = (tile / ntilesx) * tileheight, y1 = min(sz, y0 + tileheight);
+			auto t0 = high_resolution_clock::now();
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++)
+					mObstructionMap.set(x, y, isblocked(x * cellsize + 0.5f * cellsize, y * cellsize + 0.5f * cellsize));
+			}
+			auto t1 = high_resolution_clock::now();
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					if (!mObstructionMap.get(x, y) && terrainslope(x * cellsize + 0.5f * cellsize, y * cellsize + 0.5f * cellsize) > 0.95f)
+						mObstructionMap.set(x, y, true);
 				}
-				else {
-					mObstructionMap.set(x, y, false);
+			}
+			auto t2 = high_resolution_clock::now();
+			for (int y = y0; y < y1; y++) {
+				for (int x = x0; x < x1; x++) {
+					if (!mObstructionMap.get(x, y) && testrectinscenery(x * cellsize, y * cellsize, cellsize, cellsize, 20.f))
+						mObstructionMap.set(x, y, true);
 				}
 			}
+			auto t3 = high_resolution_clock::now();
+			ws.blockers += duration<double, std::milli>(t1 - t0).count();
+			ws.slope += duration<double, std::milli>(t2 - t1).count();
+			ws.scenery += duration<double, std::milli>(t3 - t2).count();
+		});
+		double wall = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+
+		double blockers = 0.0, slope = 0.0, scenery = 0.0;
+		for (auto& ws : times) {
+			blockers += ws.blockers;
+			slope += ws.slope;
+			scenery += ws.scenery;
 		}
+		core::info("Obstruction map %dx%d: %d tiles on %d threads in %.2fms (cpu: blockers %.2fms, slope %.2fms, scenery %.2fms)\n",
+			sz, sz, ntiles, pool.size(), wall, blockers, slope, scenery);
 	}
 
-	void world::init() {
+	void world::initsize() {
 		assert(mConfig.size < 31);
 		mWorldDefinitionSize = (1 << mConfig.size) + 1;
 		mWorldSize = mConfig.scale * mWorldDefinitionSize;
+	}
 
-		mPropsQt = std::make_unique<core::quadtree<worldprop>>(mWorldSize, mWorldSize, 50.f);
+	void world::buildpropindex() {
+		vector<core::spatialgrid<worldprop>::item> items;
+		items.reserve(mProps.size());
 		for (auto& prop : mProps) {
 			auto bbmin = prop.model->BBMin() * prop.scale;
 			auto bbmax = prop.model->BBMax() * prop.scale;
@@ -192,157 +363,694 @@ namespace s2 {
 			c1 += prop.pos; c2 += prop.pos; c3 += prop.pos; c4 += prop.pos;
 			vector3f nmin(min({ c1.x, c2.x, c3.x, c4.x }), min({ c1.y, c2.y, c3.y, c4.y }), 0.f);
 			vector3f nmax(max({ c1.x,c2.x,c3.x,c4.x }), max({ c1.y,c2.y,c3.y,c4.y }), 0.f);
-			mPropsQt->insert(core::rect(nmin.x, nmin.y, nmax.x - nmin.x, nmax.y - nmin.y), &prop);
+			items.push_back({ core::rect(nmin.x, nmin.y, nmax.x - nmin.x, nmax.y - nmin.y), &prop });
+		}
+		mPropIndex.build(mWorldSize, mWorldSize, PropCellSize, items);
+		mPropObbs.build(mProps);
+	}
+
+	void propobbtable::build(const vector<worldprop>& props) {
+		for (auto* v : { &cx, &cy, &hx, &hy, &ux, &uy, &ex, &ey, &ox, &oy, &reachsq })
+			v->resize(props.size());
+		for (size_t i = 0; i < props.size(); i++) {
+			auto& p = props[i];
+			auto min = p.model->BBMin() * p.scale;
+			auto max = p.model->BBMax() * p.scale;
+			auto mrot = mat4f::zrotation(-p.angles.z * float(M_PI) / 180.f);
+			auto axis = mrot * vector3f(1.f, 0.f, 0.f);
+			auto centre = mrot * vector3f((min.x + max.x) * 0.5f, (min.y + max.y) * 0.5f, 0.f);
+			cx[i] = p.pos.x + centre.x;
+			cy[i] = p.pos.y + centre.y;
+			hx[i] = abs(max.x - min.x) * 0.5f;
+			hy[i] = abs(max.y - min.y) * 0.5f;
+			ux[i] = axis.x;
+			uy[i] = axis.y;
+			ex[i] = hx[i] * abs(axis.x) + hy[i] * abs(axis.y);
+			ey[i] = hx[i] * abs(axis.y) + hy[i] * abs(axis.x);
+			ox[i] = p.pos.x;
+			oy[i] = p.pos.y;
+			float largestSide = std::max(max.x - min.x, max.y - min.y);
+			reachsq[i] = p.angles.z == 0.f ? std::numeric_limits<float>::infinity() : largestSide * largestSide;
 		}
+	}
+
+	void world::init() {
+		initsize();
+		buildpropindex();
+		buildslopemaps();
 
 		core::info("Generating obstruction map...\n");
-		generateobstructionmap(32.f);
+		generateobstructionmap(ObstructionCellSize);
+		buildobstructioncolumns();
+		buildclearancefield();
 		core::info("Finished generating obstruction map.\n");
 		
-		float nmCellSize = 64.f;
-		int nmSize = int(mWorldSize / nmCellSize);
+		int nmSize = int(mWorldSize / NavCellSize);
 		mNavmesh = std::make_shared<navmesh2d>(nmSize, nmSize, mWorldSize, mWorldSize);
 		core::info("Generating navigation mesh...\n");
-		int nlinks = mNavmesh->generate([this](auto&&...args) -> bool { return testlineobstructed(args...); }, 40.f);
-		core::info("Generated %dx%d navmesh with %d links\n", nmSize, nmSize, nlinks);
-	}
-
-	bool world::testrectinscenery(float x, float y, float w, float h, float radius) {
-		vector3f min, max;
-		auto results = mPropsQt->query(core::rect(x - radius, y - radius, w + radius * 2.f, h + radius * 2.f));
-		for (auto& pP : results) {
-			auto& p = *pP;
-			min = p.model->BBMin();
-			min *= p.scale;
-			min.z = 0.f;
-			max = p.model->BBMax();
-			max *= p.scale;
-			max.z = 0.f;
-			vector3f pos = vector3f(x - p.pos.x, y - p.pos.y, 0.f);
-			auto largestSideSq = std::max((max.x - min.x)*(max.x-min.x), (max.y - min.y)*(max.y - min.y));
-			if (p.angles.z == 0.f) {
-				// test two axis-aligned rects w simplified SAT test
-				if (!( (pos.x - max.x) > radius
-					|| radius < (min.x - (pos.x + w))
-					|| (pos.y - max.y) > radius
-					|| radius < (min.y - (pos.y + h))))
-					return true;
+		auto start = high_resolution_clock::now();
+		int nlinks = mNavmesh->generate([this](auto&&...args) { linesobstructed(args...); }, NavCapsuleWidth,
+			[this](auto&&...args) { linkclearance(args...); });
+		double elapsed = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+		core::info("Generated %dx%d navmesh with %d links in %.2fms\n", nmSize, nmSize, nlinks, elapsed);
+		buildnavhierarchy();
+	}
+
+	void world::buildnavhierarchy() {
+		mNavHierarchy = std::make_shared<navhierarchy>(mNavmesh);
+		mNavHierarchy->build();
+	}
+
+	namespace {
+		inline __m128 gather(const vector<float>& v, const int* idx) {
+			return _mm_setr_ps(v[idx[0]], v[idx[1]], v[idx[2]], v[idx[3]]);
+		}
+		inline __m128 absps(__m128 v) {
+			return _mm_andnot_ps(_mm_set1_ps(-0.f), v);
+		}
+		// Feeds the props in area to test four at a time (a short last batch repeats its first
+		// prop) and stops at the first batch whose lane mask has a hit.
+		template<typename Test>
+		bool anyprop(const core::spatialgrid<worldprop>& index, const worldprop* first, const core::rect& area, Test&& test) {
+			int idx[4], n = 0;
+			if (index.visit(area, [&](const worldprop* p) {
+				idx[n++] = int(p - first);
+				if (n < 4)
+					return false;
+				n = 0;
+				return _mm_movemask_ps(test(idx)) != 0;
+			}))
+				return true;
+			if (n == 0)
+				return false;
+			for (int k = n; k < 4; k++)
+				idx[k] = idx[0];
+			return _mm_movemask_ps(test(idx)) != 0;
+		}
+	}
+
+	bool world::testrectinscenery(float x, float y, float w, float h, float radius)const {
+		// Separating axis test of the rect, grown by radius, against each box on the world axes and
+		// the box's own two axes.
+		const auto& t = mPropObbs;
+		const __m128 r = _mm_set1_ps(radius);
+		const __m128 rx0 = _mm_set1_ps(x), rx1 = _mm_set1_ps(x + w);
+		const __m128 ry0 = _mm_set1_ps(y), ry1 = _mm_set1_ps(y + h);
+		const __m128 rcx = _mm_set1_ps(x + w * 0.5f), rcy = _mm_set1_ps(y + h * 0.5f);
+		const __m128 rhw = _mm_set1_ps(w * 0.5f), rhh = _mm_set1_ps(h * 0.5f);
+		auto area = core::rect(x - radius, y - radius, w + radius * 2.f, h + radius * 2.f);
+		return anyprop(mPropIndex, mProps.data(), area, [&](const int* idx) {
+			__m128 cx = gather(t.cx, idx), cy = gather(t.cy, idx);
+			__m128 ex = gather(t.ex, idx), ey = gather(t.ey, idx);
+			__m128 ux = gather(t.ux, idx), uy = gather(t.uy, idx);
+			__m128 sep = _mm_or_ps(
+				_mm_cmpgt_ps(_mm_sub_ps(rx0, _mm_add_ps(cx, ex)), r),
+				_mm_cmpgt_ps(_mm_sub_ps(_mm_sub_ps(cx, ex), rx1), r));
+			sep = _mm_or_ps(sep, _mm_or_ps(
+				_mm_cmpgt_ps(_mm_sub_ps(ry0, _mm_add_ps(cy, ey)), r),
+				_mm_cmpgt_ps(_mm_sub_ps(_mm_sub_ps(cy, ey), ry1), r)));
+			__m128 dx = _mm_sub_ps(rcx, cx), dy = _mm_sub_ps(rcy, cy);
+			__m128 aux = absps(ux), auy = absps(uy);
+			__m128 d1 = absps(_mm_add_ps(_mm_mul_ps(dx, ux), _mm_mul_ps(dy, uy)));
+			__m128 e1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rhw, aux), _mm_mul_ps(rhh, auy)), gather(t.hx, idx));
+			__m128 d2 = absps(_mm_sub_ps(_mm_mul_ps(dy, ux), _mm_mul_ps(dx, uy)));
+			__m128 e2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rhw, auy), _mm_mul_ps(rhh, aux)), gather(t.hy, idx));
+			sep = _mm_or_ps(sep, _mm_cmpgt_ps(_mm_sub_ps(d1, e1), r));
+			sep = _mm_or_ps(sep, _mm_cmpgt_ps(_mm_sub_ps(d2, e2), r));
+			__m128 ox = _mm_sub_ps(rx0, gather(t.ox, idx)), oy = _mm_sub_ps(ry0, gather(t.oy, idx));
+			__m128 reach = _mm_cmplt_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), gather(t.reachsq, idx));
+			return _mm_andnot_ps(sep, reach);
+		});
+	}
+
+	bool world::testpointinscenery(float x, float y)const {
+		const auto& t = mPropObbs;
+		const __m128 px = _mm_set1_ps(x), py = _mm_set1_ps(y);
+		return anyprop(mPropIndex, mProps.data(), core::rect(x - 0.5f, y - 0.5f, 1.f, 1.f), [&](const int* idx) {
+			__m128 dx = _mm_sub_ps(px, gather(t.cx, idx)), dy = _mm_sub_ps(py, gather(t.cy, idx));
+			__m128 ux = gather(t.ux, idx), uy = gather(t.uy, idx);
+			__m128 d1 = absps(_mm_add_ps(_mm_mul_ps(dx, ux), _mm_mul_ps(dy, uy)));
+			__m128 d2 = absps(_mm_sub_ps(_mm_mul_ps(dy, ux), _mm_mul_ps(dx, uy)));
+			return _mm_and_ps(_mm_cmple_ps(d1, gather(t.hx, idx)), _mm_cmple_ps(d2, gather(t.hy, idx)));
+		});
+	}
+
+	void world::buildobstructioncolumns() {
+		int w = mObstructionMap.getwidth(), h = mObstructionMap.getheight();
+		mObstructionColumns.initialize(h, w);
+		for (int y = 0; y < h; y++) {
+			const uint64_t* row = mObstructionMap.row(y);
+			for (int wi = 0; wi < mObstructionMap.stride(); wi++) {
+				for (uint64_t bits = row[wi]; bits; bits &= bits - 1)
+					mObstructionColumns.set(y, (wi << 6) + std::countr_zero(bits), true);
 			}
-			else if(largestSideSq > pos.lengthsq()) {
-				auto c1 = min; auto c2 = vector3f(min.x, max.y, min.z); auto c3 = max; auto c4 = vector3f(max.x, min.y, max.z);
-				c1.z = c2.z = c3.z = c4.z = 0.f;
-				auto mrot = mat4f::zrotation(-p.angles.z * float(M_PI) / 180.f);
-				c1 = mrot * c1; c2 = mrot * c2; c3 = mrot * c3; c4 = mrot * c4;
-				auto xaxis = vector3f(1.f, 0.f, 0.f);
-				auto yaxis = vector3f(0.f, 1.f, 0.f);
-				auto a1 = mrot * xaxis;
-				auto a2 = mrot * yaxis;
-				vector3f ra[4] = { pos, pos + xaxis * w, pos + xaxis * w + yaxis * h, pos + yaxis * h };
-				vector3f rb[4] = { c1, c2, c3, c4 };
-				vector3f separating_axes[] = { xaxis, yaxis, a1, a2 };
-				bool separated = false;
-				for (int i = 0; i < (sizeof(separating_axes) / sizeof(separating_axes[0])); i++) {
-					auto& axis = separating_axes[i];
-					float aprojs[4] = { ra[0].dot(axis), ra[1].dot(axis), ra[2].dot(axis), ra[3].dot(axis) };
-					float bprojs[4] = { rb[0].dot(axis), rb[1].dot(axis), rb[2].dot(axis), rb[3].dot(axis) };
-					float mina = std::min(aprojs[0], std::min(aprojs[1], std::min(aprojs[2], aprojs[3])));
-					float maxa = std::max(aprojs[0], std::max(aprojs[1], std::max(aprojs[2], aprojs[3])));
-					float minb = std::min(bprojs[0], std::min(bprojs[1], std::min(bprojs[2], bprojs[3])));
-					float maxb = std::max(bprojs[0], std::max(bprojs[1], std::max(bprojs[2], bprojs[3])));
-					if ((mina - maxb) > radius
-					 || (minb - maxa) > radius) {
-						separated = true;
+		}
+	}
+
+	namespace {
+		struct edtscratch {
+			vector<float> f, d;
+			vector<int> v;
+			vector<double> z;
+
+			void resize(int n) {
+				f.resize(n); d.resize(n); v.resize(n); z.resize(n + 1);
+			}
+		};
+		// d[q] = min over p of (q - p)^2 + f[p]; sites with f[p] = inf are left out of the envelope.
+		void edt(edtscratch& es, int n) {
+			const float inf = std::numeric_limits<float>::infinity();
+			auto& f = es.f; auto& d = es.d; auto& v = es.v; auto& z = es.z;
+			int k = -1;
+			for (int q = 0; q < n; q++) {
+				if (f[q] == inf)
+					continue;
+				double s = -std::numeric_limits<double>::infinity();
+				while (k >= 0) {
+					s = ((f[q] + double(q) * q) - (f[v[k]] + double(v[k]) * v[k])) / (2.0 * q - 2.0 * v[k]);
+					if (s > z[k])
 						break;
-					}
+					k--;
 				}
-				if (!separated)
-					return true;
+				k++;
+				v[k] = q;
+				z[k] = s;
+				z[k + 1] = std::numeric_limits<double>::infinity();
+			}
+			if (k < 0) {
+				std::fill(d.begin(), d.begin() + n, inf);
+				return;
+			}
+			k = 0;
+			for (int q = 0; q < n; q++) {
+				while (z[k + 1] < q)
+					k++;
+				d[q] = float(q - v[k]) * float(q - v[k]) + f[v[k]];
 			}
 		}
-		return false;
 	}
 
-	bool world::testpointinscenery(float x, float y) {
-		auto results = mPropsQt->query(core::rect(x - 0.5f, y - 0.5f, 1.f, 1.f));
-		for (auto& pP : results) {
-			auto& p = *pP;
-			auto min = p.model->BBMin() * p.scale; min.z = 0.f;
-			auto max = p.model->BBMax() * p.scale; max.z = 0.f;
-			vector3f pos = vector3f(x, y, 0.f) - p.pos;
-			pos.z = 0.f;
-			if (p.angles.z == 0.f) {
-				if (pos.x >= min.x && pos.x <= max.x
-					&& pos.y >= min.y && pos.y <= max.y)
-					return true;
+	void world::buildclearancefield() {
+		// Exact Euclidean distance transform (Felzenszwalb & Huttenlocher): each column, then each
+		// row of the column results, takes the lower envelope of the parabolas rooted at its sites.
+		// Lines are independent within a pass, so both passes run on the pool.
+		auto start = high_resolution_clock::now();
+		int w = mObstructionMap.getwidth(), h = mObstructionMap.getheight();
+		const float inf = std::numeric_limits<float>::infinity();
+		mClearance.initialize(w, h);
+		auto& pool = core::threadpool::Instance();
+		vector<edtscratch> scratch(pool.size());
+		for (auto& es : scratch)
+			es.resize(max(w, h));
+		pool.parallel_for(w, [&](int x, int worker) {
+			auto& es = scratch[worker];
+			for (int y = 0; y < h; y++)
+				es.f[y] = mObstructionMap.get(x, y) ? 0.f : inf;
+			edt(es, h);
+			for (int y = 0; y < h; y++)
+				mClearance.set(x, y, es.d[y]);
+		});
+		const float cellsize = mWorldSize / w;
+		pool.parallel_for(h, [&](int y, int worker) {
+			auto& es = scratch[worker];
+			for (int x = 0; x < w; x++)
+				es.f[x] = mClearance.get(x, y);
+			edt(es, w);
+			for (int x = 0; x < w; x++)
+				mClearance.set(x, y, min(MaxClearance, sqrtf(es.d[x]) * cellsize));
+		});
+		double elapsed = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+		core::info("Built %dx%d clearance field in %.2fms\n", w, h, elapsed);
+	}
+
+	void world::updateclearance(int x0, int y0, int x1, int y1) {
+		// Clearance saturates at MaxClearance, so only cells within that distance of the changed
+		// ones can change, and only obstructions within that distance of those cells matter: the
+		// same transform over a window twice as far out gives their exact values.
+		int w = mObstructionMap.getwidth(), h = mObstructionMap.getheight();
+		const float inf = std::numeric_limits<float>::infinity();
+		const float cellsize = mWorldSize / w;
+		int reach = int(std::ceil(MaxClearance / cellsize));
+		int wx0 = max(0, x0 - reach), wy0 = max(0, y0 - reach), wx1 = min(w - 1, x1 + reach), wy1 = min(h - 1, y1 + reach);
+		int sx0 = max(0, wx0 - reach), sy0 = max(0, wy0 - reach), sx1 = min(w - 1, wx1 + reach), sy1 = min(h - 1, wy1 + reach);
+		int sw = sx1 - sx0 + 1, sh = sy1 - sy0 + 1;
+		edtscratch es;
+		es.resize(max(sw, sh));
+		vector<float> columns(size_t(sw) * sh);
+		for (int x = 0; x < sw; x++) {
+			for (int y = 0; y < sh; y++)
+				es.f[y] = mObstructionMap.get(sx0 + x, sy0 + y) ? 0.f : inf;
+			edt(es, sh);
+			for (int y = 0; y < sh; y++)
+				columns[size_t(y) * sw + x] = es.d[y];
+		}
+		for (int y = wy0; y <= wy1; y++) {
+			std::copy_n(&columns[size_t(y - sy0) * sw], sw, es.f.begin());
+			edt(es, sw);
+			for (int x = wx0; x <= wx1; x++)
+				mClearance.set(x, y, min(MaxClearance, sqrtf(es.d[x - sx0]) * cellsize));
+		}
+	}
+
+	float world::clearance(float x, float y) const {
+		std::shared_lock lock(mMutex);
+		return clearanceat(x, y);
+	}
+
+	float world::clearanceat(float x, float y) const {
+		int w = mClearance.getwidth(), h = mClearance.getheight();
+		int xi = min(w - 1, int((max(0.f, min(mWorldSize, x)) / mWorldSize) * w));
+		int yi = min(h - 1, int((max(0.f, min(mWorldSize, y)) / mWorldSize) * h));
+		return mClearance.get(xi, yi);
+	}
+
+	bool world::testsegmentclearance(float x0, float y0, float x1, float y1, float radius) const {
+		std::shared_lock lock(mMutex);
+		return segmentclear(x0, y0, x1, y1, radius);
+	}
+
+	bool world::segmentclear(float x0, float y0, float x1, float y1, float radius) const {
+		// Walks the cells under the segment in order. A cell with clearance c vouches for every
+		// point within c - radius - sqrt(2) cells of it along the segment, so open stretches are
+		// crossed in a few jumps and only the cells near obstacles are visited one by one.
+		const float cellsize = mWorldSize / mClearance.getwidth();
+		const float slack = 1.5f * cellsize, nudge = 1e-3f * cellsize;
+		float dx = x1 - x0, dy = y1 - y0;
+		float length = sqrtf(dx * dx + dy * dy);
+		float dirx = length > 0.f ? dx / length : 0.f, diry = length > 0.f ? dy / length : 0.f;
+		for (float t = 0.f;; ) {
+			float px = x0 + dirx * t, py = y0 + diry * t;
+			float c = clearanceat(px, py);
+			if (c < radius)
+				return false;
+			if (t >= length)
+				return true;
+			float skip = c - radius - slack;
+			if (skip <= 0.f) {
+				// Distance to the current cell's far edges.
+				float cx = std::floor(px / cellsize) * cellsize, cy = std::floor(py / cellsize) * cellsize;
+				float tx = dirx > 0.f ? (cx + cellsize - px) / dirx : dirx < 0.f ? (cx - px) / dirx : length;
+				float ty = diry > 0.f ? (cy + cellsize - py) / diry : diry < 0.f ? (cy - py) / diry : length;
+				skip = min(tx, ty);
 			}
-			else {
-				auto c1 = min; auto c2 = vector3f(min.x, max.y, min.z); auto c3 = max; auto c4 = vector3f(max.x, min.y, max.z);
-				auto width = abs(max.x - min.x);
-				auto height = abs(max.y - min.y);
-				auto mrot = mat4f::zrotation(-p.angles.z * float(M_PI) / 180.f);
-				c1 = mrot * c1; c2 = mrot * c2; c3 = mrot * c3; c4 = mrot * c4;
-				auto c12pos = pos - c1;
-				float xv = c12pos.dot((c4 - c1).unit());
-				float yv = c12pos.dot((c2 - c1).unit());
-				if (xv >= 0.f && xv <= width && yv >= 0.f && yv <= height)
+			t = min(length, t + skip + nudge);
+		}
+	}
+
+	void world::linkclearance(float x0, float y0, const float* x1, const float* y1, int count, navmesh2d::linkstate* states) const {
+		// A cell with clearance c has no point nearer than c - sqrt(2) cells to an obstructed cell,
+		// and every point of a link's capsule rays lies within its length plus NavCapsuleWidth of
+		// the node, also once clamped to the grid. So the node's own clearance opens every link
+		// short enough, and a link starting or ending in an obstructed cell has its centre ray
+		// blocked. Walking the field along the rest costs more than the rays.
+		const float cellsize = mWorldSize / mClearance.getwidth();
+		const float c0 = clearanceat(x0, y0), reach = c0 - 1.5f * cellsize - NavCapsuleWidth;
+		for (int i = 0; i < count; i++) {
+			float dx = x1[i] - x0, dy = y1[i] - y0;
+			if (c0 <= 0.f || clearanceat(x1[i], y1[i]) <= 0.f)
+				states[i] = navmesh2d::linkstate::obstructed;
+			else if (reach > 0.f && dx * dx + dy * dy <= reach * reach)
+				states[i] = navmesh2d::linkstate::open;
+			else
+				states[i] = navmesh2d::linkstate::unknown;
+		}
+	}
+
+	namespace {
+		// Whether any cell from..to (inclusive, either order) of a grid row is set. Line endpoints
+		// are clamped to the grid beforehand, so runs never need clipping.
+		inline bool runblocked(const core::bitgrid& grid, int row, int from, int to) {
+			if (from > to)
+				std::swap(from, to);
+			const uint64_t* words = grid.row(row);
+			int w0 = from >> 6, w1 = to >> 6;
+			uint64_t lo = ~0ull << (from & 63), hi = ~0ull >> (63 - (to & 63));
+			if (w0 == w1)
+				return (words[w0] & lo & hi) != 0;
+			if (words[w0] & lo)
+				return true;
+			for (int w = w0 + 1; w < w1; w++) {
+				if (words[w])
 					return true;
 			}
+			return (words[w1] & hi) != 0;
 		}
-		return false;
 	}
 
-	bool world::testlineobstructed(float x0, float y0, float x1, float y1) {
-		x0 = max(0.f, min(mWorldSize, x0));
-		y0 = max(0.f, min(mWorldSize, y0));
-		x1 = max(0.f, min(mWorldSize, x1));
-		y1 = max(0.f, min(mWorldSize, y1));
-		int x0i = int((x0 / mWorldSize) * mObstructionMap.getwidth());
-		int y0i = int((y0 / mWorldSize) * mObstructionMap.getheight());
-		int x1i = int((x1 / mWorldSize) * mObstructionMap.getwidth());
-		int y1i = int((y1 / mWorldSize) * mObstructionMap.getheight());
+	bool world::testcellsobstructed(int x0, int y0, int x1, int y1) const {
+		// Same cells as walking core::bresenham, which never tests anything for a zero-length line.
+		// Runs along x are tested a word at a time in the obstruction map, runs along y in its
+		// transposed copy.
+		if (x0 == x1 && y0 == y1)
+			return false;
+		const auto& grid = abs(x1 - x0) >= abs(y1 - y0) ? (const core::bitgrid&)mObstructionMap : mObstructionColumns;
+		return core::bresenhamruns(x0, y0, x1, y1, [&grid](int minor, int from, int to) {
+			return runblocked(grid, minor, from, to);
+		});
+	}
 
-		auto line = core::bresenham(x0i, y0i, x1i, y1i);
-		while (!line.finished()) {
-			auto nxt = line.next();
+	bool world::testlineobstructed(float x0, float y0, float x1, float y1) const {
+		std::shared_lock lock(mMutex);
+		return lineobstructed(x0, y0, x1, y1);
+	}
 
-			if (mObstructionMap.get(nxt.x, nxt.y) == true)
-				return true;
+	bool world::lineobstructed(float x0, float y0, float x1, float y1) const {
+		int w = mObstructionMap.getwidth(), h = mObstructionMap.getheight();
+		auto tocell = [this](float v, int cells) {
+			return min(cells - 1, int((max(0.f, min(mWorldSize, v)) / mWorldSize) * cells));
+		};
+		return testcellsobstructed(tocell(x0, w), tocell(y0, h), tocell(x1, w), tocell(y1, h));
+	}
+
+	void world::testlinesobstructed(const float* x0, const float* y0, const float* x1, const float* y1, int count, bool* obstructed) const {
+		std::shared_lock lock(mMutex);
+		linesobstructed(x0, y0, x1, y1, count, obstructed);
+	}
+
+	void world::linesobstructed(const float* x0, const float* y0, const float* x1, const float* y1, int count, bool* obstructed) const {
+		// Endpoints are clamped to the world and mapped to obstruction cells four rays at a time,
+		// with the same rounding as lineobstructed.
+		const int w = mObstructionMap.getwidth(), h = mObstructionMap.getheight();
+		const __m128 size = _mm_set1_ps(mWorldSize), zero = _mm_setzero_ps();
+		const __m128 cellsx = _mm_set1_ps(float(w)), cellsy = _mm_set1_ps(float(h));
+		const __m128 lastx = _mm_set1_ps(float(w - 1)), lasty = _mm_set1_ps(float(h - 1));
+		auto tocells = [&](const float* v, const __m128& cells, const __m128& last, int* out) {
+			__m128 p = _mm_max_ps(zero, _mm_min_ps(size, _mm_loadu_ps(v)));
+			p = _mm_min_ps(last, _mm_mul_ps(_mm_div_ps(p, size), cells));
+			_mm_store_si128((__m128i*)out, _mm_cvttps_epi32(p));
+		};
+		alignas(16) int cx0[4], cy0[4], cx1[4], cy1[4];
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			tocells(x0 + i, cellsx, lastx, cx0);
+			tocells(y0 + i, cellsy, lasty, cy0);
+			tocells(x1 + i, cellsx, lastx, cx1);
+			tocells(y1 + i, cellsy, lasty, cy1);
+			for (int j = 0; j < 4; j++)
+				obstructed[i + j] = testcellsobstructed(cx0[j], cy0[j], cx1[j], cy1[j]);
 		}
-		return false;
+		for (; i < count; i++)
+			obstructed[i] = lineobstructed(x0[i], y0[i], x1[i], y1[i]);
 	}
 
 	std::shared_ptr<world> world::LoadFromFile(string_view filename) {
-		mz_zip_archive archive;
-		memset(&archive, 0, sizeof(archive));
-		if (mz_zip_reader_init_file(&archive, filename.data(), 0)) {
-			struct construct_world : public s2::world {};
-			std::shared_ptr<world> world = std::make_shared<construct_world>();
-			if (!LoadWorldConfig(world->mConfig, &archive)) {
+		// The members are independent, so each one is inflated and decoded as its own pool task
+		// and one member's decode overlaps the others' inflation. A reader's state can't be
+		// shared between threads, so every task opens its own reader over one mapping of the
+		// archive; that only re-parses the (small) central directory.
+		auto file = core::mappedfile::Open(filename);
+		if (!file)
+			return nullptr;
+
+		struct construct_world : public s2::world {};
+		std::shared_ptr<world> world = std::make_shared<construct_world>();
+		struct stage {
+			const char* member;
+			std::function<bool(mz_zip_archive*)> load;
+			bool ok = false;
+			double elapsed = 0.0;
+		};
+		stage stages[] = {
+			{ "worldconfig", [&world](mz_zip_archive* a) { return LoadWorldConfig(world->mConfig, a); } },
+			{ "heightmap", [&world](mz_zip_archive* a) { return LoadHeightmap(world->mHeightmap, a); } },
+			{ "vertexblockermap", [&world](mz_zip_archive* a) { return LoadVertexBlockers(world->mVertexBlockers, a); } },
+			{ "entitylist", [&world](mz_zip_archive* a) { return LoadProps(world->mProps, a); } },
+		};
+		auto start = high_resolution_clock::now();
+		core::threadpool::Instance().parallel_for(int(std::size(stages)), [&](int i, int) {
+			auto t0 = high_resolution_clock::now();
+			mz_zip_archive archive;
+			memset(&archive, 0, sizeof(archive));
+			if (mz_zip_reader_init_mem(&archive, file->data(), file->length(), 0)) {
+				stages[i].ok = stages[i].load(&archive);
 				mz_zip_reader_end(&archive);
-				core::error("Failed to read worldconfig for world %s.", filename);
-				return nullptr;
 			}
-			if (!LoadHeightmap(world->mHeightmap, &archive)) {
-				mz_zip_reader_end(&archive);
-				core::error("Failed to read heightmap for world %s.", filename);
+			stages[i].elapsed = duration<double, std::milli>(high_resolution_clock::now() - t0).count();
+		});
+		double wall = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+
+		double cpu = 0.0;
+		for (auto& s : stages) {
+			if (!s.ok) {
+				core::error("Failed to read %s for world %s.\n", s.member, filename);
 				return nullptr;
 			}
-			if (!LoadVertexBlockers(world->mVertexBlockers, &archive)) {
-				mz_zip_reader_end(&archive);
-				core::error("Failed to read vertexblockermap for world %s.", filename);
-				return nullptr;
+			cpu += s.elapsed;
+		}
+		core::info("Extracted world %s in %.2fms (cpu %.2fms: %s %.2fms, %s %.2fms, %s %.2fms, %s %.2fms)\n", filename, wall, cpu,
+			stages[0].member, stages[0].elapsed, stages[1].member, stages[1].elapsed,
+			stages[2].member, stages[2].elapsed, stages[3].member, stages[3].elapsed);
+		world->init();
+		return world;
+	}
+	namespace {
+		const uint32_t WorldCacheSignature = '0W2S'; // 'S2W0'
+		const uint32_t WorldCacheVersion = 8;
+		const size_t WorldCacheAlignment = 16;
+
+		class cachewriter {
+			FILE* mFile;
+			size_t mOffset = 0;
+		public:
+			cachewriter(FILE* f) : mFile(f) { }
+			void write(const void* data, size_t length) {
+				fwrite(data, length, 1, mFile);
+				mOffset += length;
 			}
-			if (!LoadProps(world->mProps, &archive)) {
-				mz_zip_reader_end(&archive);
-				core::error("Failed to read entitylist for world %s.", filename);
+			template<typename T>
+			void write(const T& v) {
+				write(&v, sizeof(T));
+			}
+			void writestring(string_view s) {
+				write(uint32_t(s.size()));
+				write(s.data(), s.size());
+			}
+			void align() {
+				static const uint8_t zeros[WorldCacheAlignment] = { };
+				size_t pad = (WorldCacheAlignment - (mOffset % WorldCacheAlignment)) % WorldCacheAlignment;
+				write(zeros, pad);
+			}
+			template<typename T>
+			void writearray(const T* data, size_t count) {
+				align();
+				write(data, sizeof(T) * count);
+			}
+		};
+
+		class cachereader {
+			const uint8_t* mData;
+			size_t mDataLength;
+			size_t mReadIdx = 0;
+			bool mOk = true;
+			const uint8_t* take(size_t length) {
+				if (!mOk || length > (mDataLength - mReadIdx)) {
+					mOk = false;
+					return nullptr;
+				}
+				auto p = mData + mReadIdx;
+				mReadIdx += length;
+				return p;
+			}
+		public:
+			cachereader(const uint8_t* data, size_t length) : mData(data), mDataLength(length) { }
+			bool ok()const { return mOk; }
+			template<typename T>
+			T read() {
+				T r{};
+				if (auto p = take(sizeof(T)))
+					memcpy(&r, p, sizeof(T));
+				return r;
+			}
+			string readstring() {
+				uint32_t len = read<uint32_t>();
+				auto p = take(len);
+				return p ? string((const char*)p, len) : string();
+			}
+			// Returns a pointer into the mapping; arrays are aligned so this is safe to use in place.
+			template<typename T>
+			const T* readarray(size_t count) {
+				mReadIdx = min(mDataLength, (mReadIdx + WorldCacheAlignment - 1) & ~(WorldCacheAlignment - 1));
+				if (count > (mDataLength - mReadIdx) / sizeof(T)) {
+					mOk = false;
+					return nullptr;
+				}
+				return (const T*)take(sizeof(T) * count);
+			}
+		};
+	}
+
+	std::shared_ptr<world> world::LoadFromCache(string_view filename) {
+		auto file = core::mappedfile::Open(filename);
+		if (!file)
+			return nullptr;
+
+		cachereader rd(file->data(), file->length());
+		if (rd.read<uint32_t>() != WorldCacheSignature || rd.read<uint32_t>() != WorldCacheVersion) {
+			core::warning("Ignoring stale world cache %s\n", filename);
+			return nullptr;
+		}
+
+		struct construct_world : public s2::world {};
+		std::shared_ptr<world> world = std::make_shared<construct_world>();
+		auto& cfg = world->mConfig;
+		cfg.name = rd.readstring();
+		cfg.size = rd.read<int>();
+		cfg.scale = rd.read<float>();
+		cfg.textureScale = rd.read<float>();
+		cfg.texelDensity = rd.read<float>();
+		cfg.groundlevel = rd.read<float>();
+		cfg.minplayersperteam = rd.read<int>();
+		cfg.maxplayers = rd.read<int>();
+		uint32_t nmusic = rd.read<uint32_t>();
+		for (uint32_t i = 0; i < nmusic && rd.ok(); i++)
+			cfg.music.push_back(rd.readstring());
+		if (!rd.ok() || cfg.size <= 0 || cfg.size >= 31)
+			return nullptr;
+		world->initsize();
+
+		// Every map must have the size a fresh generate would give it, or the lookups that index
+		// one map by another's dimensions would read out of bounds.
+		int hmsize = int(world->mWorldDefinitionSize);
+		int obsize = int(world->mWorldSize / ObstructionCellSize);
+		int nmsize = int(world->mWorldSize / NavCellSize);
+		auto readmap = [&rd]<typename T>(map2d<T>& map, int size) -> bool {
+			int w = rd.read<int>(), h = rd.read<int>();
+			if (w != size || h != size)
+				return false;
+			if constexpr (std::is_same_v<T, bool>) {
+				auto words = rd.readarray<uint64_t>(core::bitgrid::WordsFor(w, h));
+				if (!words)
+					return false;
+				map.view(words, w, h);
+			}
+			else {
+				auto data = rd.readarray<T>(size_t(w) * h);
+				if (!data)
+					return false;
+				map.view(data, w, h);
+			}
+			return true;
+		};
+		if (!readmap(world->mHeightmap, hmsize) || !readmap(world->mVertexBlockers, hmsize) ||
+			!readmap(world->mObstructionMap, obsize) || !readmap(world->mClearance, obsize)) {
+			core::warning("Ignoring world cache %s with damaged maps\n", filename);
+			return nullptr;
+		}
+		world->buildobstructioncolumns();
+		world->buildslopemaps();
+
+		uint32_t nprops = rd.read<uint32_t>();
+		world->mProps.reserve(min<size_t>(nprops, file->length()));
+		for (uint32_t i = 0; i < nprops && rd.ok(); i++) {
+			worldprop prop;
+			prop.modelname = rd.readstring();
+			prop.type = rd.readstring();
+			prop.scale = rd.read<float>();
+			prop.pos = rd.read<vector3f>();
+			prop.angles = rd.read<vector3f>();
+			prop.model = gResourceManager->LookupModel(prop.modelname);
+			if (!prop.model) {
+				core::warning("World cache %s references unknown model %s\n", filename, prop.modelname);
 				return nullptr;
 			}
-			world->init();
-			mz_zip_reader_end(&archive);
-			return world;
+			world->mProps.push_back(std::move(prop));
+		}
+
+		int nmw = rd.read<int>(), nmh = rd.read<int>();
+		uint32_t nlinks = rd.read<uint32_t>();
+		if (!rd.ok() || nmw != nmsize || nmh != nmsize) {
+			core::warning("Ignoring world cache %s with a mismatched navmesh\n", filename);
+			return nullptr;
+		}
+		auto offsets = rd.readarray<uint32_t>(size_t(nmw) * nmh + 1);
+		auto links = rd.readarray<navmesh2d::nodelink>(nlinks);
+		if (!rd.ok())
+			return nullptr;
+		world->mNavmesh = std::make_shared<navmesh2d>(nmw, nmh, world->mWorldSize, world->mWorldSize);
+		if (!world->mNavmesh->attachlinks(std::span(offsets, size_t(nmw) * nmh + 1), std::span(links, nlinks))) {
+			core::warning("Ignoring world cache %s with damaged navmesh links\n", filename);
+			return nullptr;
+		}
+		world->buildnavhierarchy();
+
+		world->buildpropindex();
+		world->mCacheFile = std::move(file);
+		core::info("Loaded world %s from cache %s\n", cfg.name, filename);
+		return world;
+	}
+
+	bool world::SaveCache(string_view filename) const {
+		std::shared_lock lock(mMutex);
+		if (!mBlockers.empty()) {
+			core::warning("Not caching world %s with %zu blockers placed\n", mConfig.name, mBlockers.size());
+			return false;
+		}
+		// Write to a temporary file and move it into place, so other processes never map a partial cache.
+		auto tmpname = core::format("%s.%08x.tmp", filename, core::random::uint32());
+		FILE* f = fopen(tmpname.c_str(), "wb");
+		if (!f) {
+			core::warning("Couldn't write world cache %s\n", tmpname);
+			return false;
+		}
+		cachewriter wr(f);
+		wr.write(WorldCacheSignature);
+		wr.write(WorldCacheVersion);
+		wr.writestring(mConfig.name);
+		wr.write(mConfig.size);
+		wr.write(mConfig.scale);
+		wr.write(mConfig.textureScale);
+		wr.write(mConfig.texelDensity);
+		wr.write(mConfig.groundlevel);
+		wr.write(mConfig.minplayersperteam);
+		wr.write(mConfig.maxplayers);
+		wr.write(uint32_t(mConfig.music.size()));
+		for (auto& m : mConfig.music)
+			wr.writestring(m);
+
+		auto writemap = [&wr]<typename T>(const map2d<T>& map) {
+			wr.write(map.getwidth());
+			wr.write(map.getheight());
+			if constexpr (std::is_same_v<T, bool>)
+				wr.writearray(map.words(), map.numwords());
+			else
+				wr.writearray(map.raw(), size_t(map.getwidth()) * map.getheight());
+		};
+		writemap(mHeightmap);
+		writemap(mVertexBlockers);
+		writemap(mObstructionMap);
+		writemap(mClearance);
+
+		wr.write(uint32_t(mProps.size()));
+		for (auto& prop : mProps) {
+			wr.writestring(prop.modelname);
+			wr.writestring(prop.type);
+			wr.write(prop.scale);
+			wr.write(prop.pos);
+			wr.write(prop.angles);
+		}
+
+		auto offsets = mNavmesh->linkoffsets();
+		auto links = mNavmesh->linkarray();
+		wr.write(mNavmesh->width());
+		wr.write(mNavmesh->height());
+		wr.write(uint32_t(links.size()));
+		wr.writearray(offsets.data(), offsets.size());
+		wr.writearray(links.data(), links.size());
+
+		bool ok = !ferror(f);
+		fclose(f);
+		std::error_code ec;
+		if (ok)
+			std::filesystem::rename(tmpname, string(filename), ec);
+		if (!ok || ec) {
+			std::filesystem::remove(tmpname, ec);
+			core::warning("Couldn't write world cache %s\n", filename);
+			return false;
 		}
-		return nullptr;
+		core::info("Wrote world cache %s\n", filename);
+		return true;
 	}
+
 	string_view world::name() const {
 		return mConfig.name;
 	}
@@ -378,51 +1086,95 @@ namespace s2 {
 		return core::bilinear(q11, q12, q21, q22, hmx - xi, hmy - yi);
 	}
 	float world::terrainslope(float worldx, float worldy) const {
-		float ht = terrainheight(worldx, worldy);
-		float bdx = terrainheight(worldx - 1.f, worldy) - ht;
-		float fdx = terrainheight(worldx + 1.f, worldy) - ht;
-		float bdy = terrainheight(worldx, worldy - 1.f) - ht;
-		float fdy = terrainheight(worldx, worldy + 1.f) - ht;
-		return max(sqrtf(fdx * fdx + fdy * fdy), sqrtf(bdx * bdx + bdy * bdy));
-
+		// Gradient of the bilinear height surface: the x slope blends the rise along the cell's
+		// bottom and top edges, the y slope the rise along its left and right edges.
 		float hmx = ((worldx / mWorldSize) * mHeightmap.getwidth());
 		float hmy = ((worldy / mWorldSize) * mHeightmap.getheight());
-		int xi = int(hmx);
-		int yi = int(hmy);
-		int xi2 = xi + 1;
-		int yi2 = yi + 1;
-		if (xi2 >= mHeightmap.getwidth())
-			xi2 = xi;
-		if (yi2 >= mHeightmap.getwidth())
-			yi2 = yi;
-		float q11 = mHeightmap.get(xi, yi);
-		float q21 = mHeightmap.get(xi2, yi);
-		float q12 = mHeightmap.get(xi, yi2);
-		float q22 = mHeightmap.get(xi2, yi2);
+		int xi = max(0, min(mHeightmap.getwidth() - 1, int(hmx)));
+		int yi = max(0, min(mHeightmap.getheight() - 1, int(hmy)));
+		int yi2 = min(yi + 1, mHeightmap.getheight() - 1);
+		int xi2 = min(xi + 1, mHeightmap.getwidth() - 1);
+		float fx = hmx - xi, fy = hmy - yi;
+		float gx = (1.f - fy) * mSlopeX.get(xi, yi) + fy * mSlopeX.get(xi, yi2);
+		float gy = (1.f - fx) * mSlopeY.get(xi, yi) + fx * mSlopeY.get(xi2, yi);
+		return sqrtf(gx * gx + gy * gy);
+	}
 
+	float world::maxterrainslope(float x0, float y0, float x1, float y1) const {
+		if (mSlopeMips.empty())
+			return 0.f;
+		auto& base = mSlopeMips.front();
+		auto cellx = [&](float x) { return max(0, min(base.getwidth() - 1, int((x / mWorldSize) * mHeightmap.getwidth()))); };
+		auto celly = [&](float y) { return max(0, min(base.getheight() - 1, int((y / mWorldSize) * mHeightmap.getheight()))); };
+		int cx0 = cellx(min(x0, x1)), cx1 = cellx(max(x0, x1));
+		int cy0 = celly(min(y0, y1)), cy1 = celly(max(y0, y1));
+		// Coarsest useful level: the rect covers at most 4x4 entries there. An unaligned rect can
+		// straddle one more entry than its width suggests, so count the entries themselves.
+		int level = 0;
+		while (level + 1 < int(mSlopeMips.size()) && max((cx1 >> level) - (cx0 >> level), (cy1 >> level) - (cy0 >> level)) > 3)
+			level++;
+		auto& mip = mSlopeMips[level];
+		float result = 0.f;
+		for (int y = cy0 >> level; y <= (cy1 >> level); y++) {
+			for (int x = cx0 >> level; x <= (cx1 >> level); x++)
+				result = max(result, mip.get(x, y));
+		}
+		return result;
+	}
 
+	void world::buildslopemaps() {
+		// Rise per world unit along each heightmap edge. The last row and column have no
+		// neighbour and stay flat, as terrainheight clamps there.
+		int w = mHeightmap.getwidth(), h = mHeightmap.getheight();
+		float invcellw = mHeightmap.getwidth() / mWorldSize, invcellh = mHeightmap.getheight() / mWorldSize;
+		mSlopeX.initialize(w, h);
+		mSlopeY.initialize(w, h);
+		const float* heights = mHeightmap.raw();
+		core::threadpool::Instance().parallel_for(h, [&](int y, int) {
+			const float* row = heights + size_t(y) * w;
+			const float* next = heights + size_t(min(y + 1, h - 1)) * w;
+			float* sx = &mSlopeX[y * w];
+			float* sy = &mSlopeY[y * w];
+			for (int x = 0; x + 1 < w; x++)
+				sx[x] = (row[x + 1] - row[x]) * invcellw;
+			sx[w - 1] = 0.f;
+			for (int x = 0; x < w; x++)
+				sy[x] = (next[x] - row[x]) * invcellh;
+		});
 
-		return max({ q11, q21, q12, q22 }) - min({ q11, q21, q12, q22 });
-		float cellw = mWorldSize / mHeightmap.getwidth();
-		float cellh = mWorldSize / mHeightmap.getheight();
-		float fx = max(1e-9f, hmx - xi);
-		float fy = max(1e-9f, hmy - yi);
-		float ifx = 1.f - fx;
-		float ify = 1.f - fy;
-		fx *= cellw; ifx *= cellw;
-		fy *= cellh; ify *= cellh;
-		return max(
-			max(
-				abs(ht - q11) / (sqrtf(ifx*ifx+ify*ify)),
-				abs(ht - q22) / (sqrtf(fx*fx+fy*fy))
-			),
-			max(
-				abs(ht - q21) / (sqrtf(fx*fx+ify*ify)),
-				abs(ht - q12) / (sqrtf(ifx*ifx+fy*fy))
-			)
-		);
+		// Level 0 holds each cell's steepest slope, which for a bilinear patch lies on a corner;
+		// every further level halves the resolution and keeps the maximum.
+		mSlopeMips.clear();
+		mSlopeMips.emplace_back();
+		mSlopeMips[0].initialize(w, h);
+		for (int y = 0; y < h; y++) {
+			int y2 = min(y + 1, h - 1);
+			for (int x = 0; x < w; x++) {
+				int x2 = min(x + 1, w - 1);
+				float steepest = 0.f;
+				for (float gx : { mSlopeX.get(x, y), mSlopeX.get(x, y2) }) {
+					for (float gy : { mSlopeY.get(x, y), mSlopeY.get(x2, y) })
+						steepest = max(steepest, gx * gx + gy * gy);
+				}
+				mSlopeMips[0].set(x, y, sqrtf(steepest));
+			}
+		}
+		while (mSlopeMips.back().getwidth() > 1 || mSlopeMips.back().getheight() > 1) {
+			auto& fine = mSlopeMips.back();
+			map2d<float> coarse;
+			coarse.initialize((fine.getwidth() + 1) / 2, (fine.getheight() + 1) / 2);
+			for (int y = 0; y < coarse.getheight(); y++) {
+				for (int x = 0; x < coarse.getwidth(); x++) {
+					int fx1 = min(2 * x + 1, fine.getwidth() - 1), fy1 = min(2 * y + 1, fine.getheight() - 1);
+					coarse.set(x, y, max({ fine.get(2 * x, 2 * y), fine.get(fx1, 2 * y), fine.get(2 * x, fy1), fine.get(fx1, fy1) }));
+				}
+			}
+			mSlopeMips.push_back(std::move(coarse));
+		}
 	}
+
 	vector<vector3f> world::navmeshlines() const {
+		std::shared_lock lock(mMutex);
 		auto width = mNavmesh->width();
 		auto height = mNavmesh->height();
 		vector<vector3f> lines;
@@ -430,18 +1182,37 @@ namespace s2 {
 		for (int y = 0; y < height; y++) {
 			for (int x = 0; x < width; x++) {
 				auto& node = mNavmesh->get(x, y);
-				for (auto& l : node.reachable) {
+				for (auto& l : mNavmesh->links(node)) {
+					auto& to = mNavmesh->get(l.to);
 					lines.push_back(vector3f(node.worldx, node.worldy, 0.f));
-					lines.push_back(vector3f(l.to.worldx, l.to.worldy, 0.f));
+					lines.push_back(vector3f(to.worldx, to.worldy, 0.f));
 				}
 			}
 		}
 		return lines;
 	}
-	deque<vector3f> world::pathfind(const vector3f& from, const vector3f& to, const std::function<bool(const vector3f&, const vector3f&)>& prArrived) const {
+	deque<vector3f> world::pathfind(const vector3f& from, const vector3f& to, const std::function<bool(const vector3f&, const vector3f&)>& prArrived, pathmode mode, int* numRefined) const {
+		std::shared_lock lock(mMutex);
+		return findpath(from, to, prArrived, mode, numRefined);
+	}
+
+	deque<vector3f> world::findpath(const vector3f& from, const vector3f& to, const std::function<bool(const vector3f&, const vector3f&)>& prArrived, pathmode mode, int* numRefined) const {
 		deque<vector3f> result;
 
-		auto path2d = mNavmesh->pathfind(from.x, from.y, to.x, to.y, prArrived);
+		deque<std::pair<float, float>> path2d;
+		if (mode == pathmode::hierarchical && mNavHierarchy) {
+			path2d = mNavHierarchy->pathfind(from.x, from.y, to.x, to.y, prArrived, navhierarchy::DefaultRefineSegments, numRefined);
+		}
+		else if (mode == pathmode::bidirectional) {
+			path2d = mNavmesh->pathfindbidirectional(from.x, from.y, to.x, to.y);
+			if (numRefined)
+				*numRefined = int(path2d.size());
+		}
+		else {
+			path2d = mNavmesh->pathfind(from.x, from.y, to.x, to.y, prArrived);
+			if (numRefined)
+				*numRefined = int(path2d.size());
+		}
 		for (auto& wp : path2d) {
 			auto x = wp.first;
 			auto y = wp.second;
@@ -451,4 +1222,237 @@ namespace s2 {
 
 		return result;
 	}
+
+	deque<vector3f> world::pathfindany(const vector3f& from, std::span<const vector3f> goals, int* goalIndex) const {
+		std::shared_lock lock(mMutex);
+		deque<vector3f> result;
+		for (auto& wp : mNavmesh->pathfindany(from.x, from.y, goals, goalIndex))
+			result.push_back(vector3f(wp.first, wp.second, terrainheight(wp.first, wp.second)));
+		return result;
+	}
+
+	bool world::testcapsuleobstructed(float x0, float y0, float x1, float y1, float width) const {
+		std::shared_lock lock(mMutex);
+		return capsuleobstructed(x0, y0, x1, y1, width);
+	}
+
+	bool world::capsuleobstructed(float x0, float y0, float x1, float y1, float width) const {
+		// The same three rays navmesh2d::generate casts for a link.
+		vector3f from(x0, y0, 0.f), to(x1, y1, 0.f);
+		vector3f right = (to - from).perp2d().unit() * width;
+		float rx0[3] = { from.x, from.x + right.x, from.x - right.x };
+		float ry0[3] = { from.y, from.y + right.y, from.y - right.y };
+		float rx1[3] = { to.x, to.x + right.x, to.x - right.x };
+		float ry1[3] = { to.y, to.y + right.y, to.y - right.y };
+		bool obstructed[3];
+		linesobstructed(rx0, ry0, rx1, ry1, 3, obstructed);
+		return obstructed[0] || obstructed[1] || obstructed[2];
+	}
+
+	void world::smoothpath(deque<vector3f>& path, int* numRefined) const {
+		// String pulling: from each kept waypoint, skip ahead while the capsule to the next
+		// waypoint is clear, and keep the last one that was reachable. The capsule is cast with
+		// the same rays link generation uses, so a shortcut is exactly as passable as a link;
+		// a centre-to-centre distance field either cuts corners the links avoid or, padded
+		// enough not to, keeps far more waypoints.
+		size_t end = numRefined ? size_t(max(0, min(*numRefined, int(path.size())))) : path.size();
+		if (end < 3)
+			return;
+		std::shared_lock lock(mMutex);
+		deque<vector3f> pulled;
+		pulled.push_back(path[0]);
+		size_t anchor = 0;
+		for (size_t i = 2; i < end; i++) {
+			auto& a = path[anchor];
+			if (capsuleobstructed(a.x, a.y, path[i].x, path[i].y, NavCapsuleWidth)) {
+				anchor = i - 1;
+				pulled.push_back(path[anchor]);
+			}
+		}
+		pulled.push_back(path[end - 1]);
+		if (numRefined)
+			*numRefined = int(pulled.size());
+		pulled.insert(pulled.end(), path.begin() + end, path.end());
+		path = std::move(pulled);
+	}
+
+	vector<std::future<deque<vector3f>>> world::pathfind_batch(vector<pathrequest> requests, core::threadpool& pool) const {
+		vector<std::future<deque<vector3f>>> results;
+		results.reserve(requests.size());
+		for (auto& request : requests) {
+			results.push_back(pool.submit([this, request = std::move(request)] {
+				return pathfind(request.from, request.to, request.prArrived, request.mode);
+			}));
+		}
+		return results;
+	}
+
+	deque<vector3f> world::cachedpathfind(const vector3f& from, const vector3f& to, float arrivalRadius, pathmode mode, int* numRefined) const {
+		std::shared_lock lock(mMutex);
+		int src = mNavmesh->indexat(from.x, from.y);
+		int goal = mNavmesh->indexat(to.x, to.y);
+		if (src < 0 || goal < 0)
+			return {};
+		pathcache::key key{
+			.src = src,
+			.goal = goal,
+			.radius = int(arrivalRadius / mNavmesh->cellwidth()),
+			.mode = int(mode)
+		};
+		deque<vector3f> path;
+		int refined = 0;
+		if (!mPathCache->find(key, path, refined)) {
+			path = findpath(from, to, [=](const vector3f& from, const vector3f& to) -> bool {
+				return (to - from).lengthsq() < (arrivalRadius * arrivalRadius);
+			}, mode, &refined);
+			// Waypoints sit on cell corners; offset by half a cell so rounding can't pick a neighbour.
+			vector<int> cells;
+			cells.reserve(path.size());
+			for (auto& wp : path)
+				cells.push_back(mNavmesh->indexat(wp.x + 0.5f * mNavmesh->cellwidth(), wp.y + 0.5f * mNavmesh->cellheight()));
+			mPathCache->insert(key, path, std::move(cells), refined);
+		}
+		if (numRefined)
+			*numRefined = refined;
+		return path;
+	}
+
+	std::shared_ptr<const flowfield> world::flowfieldto(const vector3f& goal) const {
+		std::shared_lock lock(mMutex);
+		return mNavmesh->flowfieldto(mNavmesh->indexat(goal.x, goal.y));
+	}
+
+	std::shared_ptr<const flowfield> world::cachedflowfield(const vector3f& goal) const {
+		std::shared_lock lock(mMutex);
+		return mNavmesh->cachedflowfield(mNavmesh->indexat(goal.x, goal.y));
+	}
+
+	int world::navcell(const vector3f& pos) const {
+		// The grid's dimensions never change, so this needs no lock.
+		return mNavmesh->indexat(pos.x, pos.y);
+	}
+
+	pathcache::stats world::pathcachestats() const {
+		std::shared_lock lock(mMutex);
+		return mPathCache->counters();
+	}
+
+	void world::clearpathcache() {
+		std::shared_lock lock(mMutex);
+		mPathCache->clear();
+	}
+
+	namespace {
+		// Axes of a blocker's box: u along its width, v = (-u.y, u.x) along its height.
+		inline void blockeraxes(const dynamicblocker& b, float& ux, float& uy) {
+			float r = b.angle * float(M_PI) / 180.f;
+			ux = cosf(r);
+			uy = sinf(r);
+		}
+		core::rect blockerbounds(const dynamicblocker& b) {
+			float ux, uy;
+			blockeraxes(b, ux, uy);
+			float ex = b.halfwidth * abs(ux) + b.halfheight * abs(uy);
+			float ey = b.halfwidth * abs(uy) + b.halfheight * abs(ux);
+			return core::rect(b.x - ex, b.y - ey, 2.f * ex, 2.f * ey);
+		}
+		// Separating axis test of an axis-aligned rect against a blocker's box; touching isn't overlapping.
+		bool rectoverlapsblocker(float x, float y, float w, float h, const dynamicblocker& b) {
+			float ux, uy;
+			blockeraxes(b, ux, uy);
+			float hw = w * 0.5f, hh = h * 0.5f;
+			float dx = x + hw - b.x, dy = y + hh - b.y;
+			if (abs(dx) >= hw + b.halfwidth * abs(ux) + b.halfheight * abs(uy))
+				return false;
+			if (abs(dy) >= hh + b.halfwidth * abs(uy) + b.halfheight * abs(ux))
+				return false;
+			if (abs(dx * ux + dy * uy) >= b.halfwidth + hw * abs(ux) + hh * abs(uy))
+				return false;
+			if (abs(dy * ux - dx * uy) >= b.halfheight + hw * abs(uy) + hh * abs(ux))
+				return false;
+			return true;
+		}
+		core::rect rectunion(const core::rect& a, const core::rect& b) {
+			float x0 = min(a.x, b.x), y0 = min(a.y, b.y);
+			return core::rect(x0, y0, max(a.x + a.w, b.x + b.w) - x0, max(a.y + a.h, b.y + b.h) - y0);
+		}
+	}
+
+	void world::setblocker(int id, const dynamicblocker& blocker) {
+		std::unique_lock lock(mMutex);
+		// A moved blocker also has to be cleared from where it was.
+		auto it = mBlockers.find(id);
+		auto area = it != mBlockers.end() ? rectunion(blockerbounds(blocker), blockerbounds(it->second)) : blockerbounds(blocker);
+		mBlockers[id] = blocker;
+		updateblockers(area);
+	}
+
+	bool world::removeblocker(int id) {
+		std::unique_lock lock(mMutex);
+		auto it = mBlockers.find(id);
+		if (it == mBlockers.end())
+			return false;
+		auto area = blockerbounds(it->second);
+		mBlockers.erase(it);
+		updateblockers(area);
+		return true;
+	}
+
+	size_t world::numblockers() const {
+		std::shared_lock lock(mMutex);
+		return mBlockers.size();
+	}
+
+	void world::updateblockers(const core::rect& area) {
+		auto start = high_resolution_clock::now();
+		int w = mObstructionMap.getwidth(), h = mObstructionMap.getheight();
+		const float cellsize = mWorldSize / w;
+		int x0 = max(0, int(std::floor(area.x / cellsize))), x1 = min(w - 1, int(std::floor((area.x + area.w) / cellsize)));
+		int y0 = max(0, int(std::floor(area.y / cellsize))), y1 = min(h - 1, int(std::floor((area.y + area.h) / cellsize)));
+		if (x0 > x1 || y0 > y1)
+			return;
+		if (mStaticObstruction.getwidth() == 0) {
+			// The maps may be views into a read-only cache mapping; edits need copies of their own.
+			mStaticObstruction = mObstructionMap;
+			mObstructionMap = map2d<bool>(mStaticObstruction);
+			mClearance = map2d<float>(mClearance);
+		}
+
+		vector<const dynamicblocker*> nearby;
+		for (auto& [id, b] : mBlockers) {
+			if (blockerbounds(b).intersects(area))
+				nearby.push_back(&b);
+		}
+		bool changed = false, opened = false;
+		for (int y = y0; y <= y1; y++) {
+			for (int x = x0; x <= x1; x++) {
+				bool blocked = mStaticObstruction.get(x, y) || std::any_of(nearby.begin(), nearby.end(), [&](const dynamicblocker* b) {
+					return rectoverlapsblocker(x * cellsize, y * cellsize, cellsize, cellsize, *b);
+				});
+				if (blocked == mObstructionMap.get(x, y))
+					continue;
+				mObstructionMap.set(x, y, blocked);
+				mObstructionColumns.set(y, x, blocked);
+				changed = true;
+				opened |= !blocked;
+			}
+		}
+		if (!changed)
+			return;
+		updateclearance(x0, y0, x1, y1);
+
+		auto dirty = core::rect(x0 * cellsize, y0 * cellsize, (x1 - x0 + 1) * cellsize, (y1 - y0 + 1) * cellsize);
+		auto nodes = mNavmesh->relink(dirty, [this](auto&&...args) { linesobstructed(args...); }, NavCapsuleWidth,
+			[this](auto&&...args) { linkclearance(args...); });
+		int nclusters = 0;
+		size_t npaths = 0;
+		if (!nodes.empty()) {
+			nclusters = mNavHierarchy->update(nodes.x0, nodes.y0, nodes.x1, nodes.y1);
+			float cw = mNavmesh->cellwidth(), ch = mNavmesh->cellheight();
+			npaths = mPathCache->invalidate(core::rect(nodes.x0 * cw, nodes.y0 * ch, (nodes.x1 - nodes.x0) * cw, (nodes.y1 - nodes.y0) * ch), opened);
+		}
+		double elapsed = duration<double, std::milli>(high_resolution_clock::now() - start).count();
+		core::info("Updated blockers over %dx%d cells: %d clusters rebuilt, %zu cached paths dropped in %.3fms\n",
+			x1 - x0 + 1, y1 - y0 + 1, nclusters, npaths, elapsed);
+	}
 }
@@ -4,7 +4,13 @@
 #include <core/math/vector3.hpp>
 #include <s2/resourcemanager.hpp>
 #include <s2/navmesh2d.hpp>
-#include <core/utils/quadtree.hpp>
+#include <s2/navhierarchy.hpp>
+#include <s2/pathcache.hpp>
+#include <core/utils/spatialgrid.hpp>
+#include <core/io/mappedfile.hpp>
+#include <core/utils/threadpool.hpp>
+#include <core/utils/bitgrid.hpp>
+#include <core/utils/rwlock.hpp>
 
 namespace s2 {
 	template<typename T>
@@ -12,10 +18,12 @@ namespace s2 {
 		T* data = nullptr;
 		int width = 0;
 		int height = 0;
+		bool owned = true;
 		void release() {
-			if (data)
+			if (data && owned)
 				delete[] data;
 			data = nullptr;
+			owned = true;
 			width = height = 0;
 		}
 	public:
@@ -27,9 +35,9 @@ namespace s2 {
 		}
 		map2d<T>(map2d<T>&& o) noexcept {
 			release();
-			data = o.data;
+			data = o.data; owned = o.owned;
 			width = o.width; height = o.height;
-			o.data = nullptr; o.width = 0; o.height = 0;
+			o.data = nullptr; o.owned = true; o.width = 0; o.height = 0;
 		}
 		~map2d<T>() {
 			release();
@@ -43,15 +51,24 @@ namespace s2 {
 		}
 		const map2d<T>& operator=(map2d<T>&& o) noexcept {
 			release();
-			data = o.data;
+			data = o.data; owned = o.owned;
 			width = o.width; height = o.height;
-			o.data = nullptr; o.width = 0; o.height = 0;
+			o.data = nullptr; o.owned = true; o.width = 0; o.height = 0;
 			return *this;
 		}
 		void initialize(int Width, int Height) {
+			release();
 			width = Width; height = Height;
 			data = new T[size_t(width) * height];
 		}
+		// Non-owning, read-only view over external storage (e.g. a mapped cache file).
+		void view(const T* Data, int Width, int Height) {
+			release();
+			width = Width; height = Height;
+			data = const_cast<T*>(Data);
+			owned = false;
+		}
+		const T* raw()const { return data; }
 
 		const T& get(int x, int y)const {
 			return data[y * width + x];
@@ -70,6 +87,13 @@ namespace s2 {
 		const int getwidth()const { return width; }
 		const int getheight()const { return height; }
 	};
+	// Boolean maps (vertex blockers, obstruction) are packed 64 cells per word.
+	template<>
+	class map2d<bool> : public core::bitgrid {
+	public:
+		const int getwidth()const { return width(); }
+		const int getheight()const { return height(); }
+	};
 	struct worldconfig {
 		string name;
 		int size;
@@ -89,6 +113,41 @@ namespace s2 {
 		vector3f angles;
 		std::shared_ptr<s2::model> model;
 	};
+	// Every prop's footprint as an oriented box, baked once in structure-of-arrays form so scenery
+	// tests can check four props per iteration. Entry i belongs to world::props()[i].
+	struct propobbtable {
+		// Centre, half extents along the box's own axes, and its x axis; its y axis is (-uy, ux).
+		vector<float> cx, cy, hx, hy, ux, uy;
+		// Half extents of the box projected onto the world axes.
+		vector<float> ex, ey;
+		// Rotated props only collide with rects whose corner lies within reach of the prop origin
+		// (ox, oy); reachsq is infinite for axis-aligned props.
+		vector<float> ox, oy, reachsq;
+
+		void build(const vector<worldprop>& props);
+		size_t size()const { return cx.size(); }
+	};
+	// Footprint of something placed during a match, such as a building: a box of the given half
+	// extents centred on (x, y), rotated about z by angle degrees like worldprop::angles.z.
+	struct dynamicblocker {
+		float x, y;
+		float halfwidth, halfheight;
+		float angle;
+	};
+	enum class pathmode {
+		flat,
+		// HPA* over the cluster graph, grid-accurate only for the first few segments.
+		hierarchical,
+		// Bidirectional A* on the flat grid, for long single-goal queries. Ignores prArrived and
+		// always ends on the goal's cell.
+		bidirectional
+	};
+	struct pathrequest {
+		vector3f from;
+		vector3f to;
+		std::function<bool(const vector3f&, const vector3f&)> prArrived;
+		pathmode mode = pathmode::flat;
+	};
 	class world {
 	private:
 		world() = default;
@@ -96,25 +155,88 @@ namespace s2 {
 		map2d<float> mHeightmap;
 		map2d<bool> mVertexBlockers;
 		map2d<bool> mObstructionMap;
+		// Transposed copy of the obstruction map, so lines that run mostly along y test whole words too.
+		core::bitgrid mObstructionColumns;
+		// Distance from each obstruction cell to the nearest obstructed one, in world units, capped
+		// at MaxClearance.
+		map2d<float> mClearance;
+		// Obstruction from the map alone, copied when the first blocker is placed.
+		map2d<bool> mStaticObstruction;
+		map<int, dynamicblocker> mBlockers;
+		// Rise per world unit from each heightmap vertex to its +x and +y neighbours.
+		map2d<float> mSlopeX, mSlopeY;
+		// Steepest slope per heightmap cell, then per 2x2, 4x4, ... block of cells.
+		vector<map2d<float>> mSlopeMips;
 		worldconfig mConfig;
 		vector<worldprop> mProps;
-		std::unique_ptr<core::quadtree<worldprop>> mPropsQt;
+		// Props by their world-space bounds, for scenery tests.
+		core::spatialgrid<worldprop> mPropIndex;
+		propobbtable mPropObbs;
 		std::shared_ptr<navmesh2d> mNavmesh;
+		std::shared_ptr<navhierarchy> mNavHierarchy;
+		std::unique_ptr<pathcache> mPathCache = std::make_unique<pathcache>();
+		// Backing storage for the maps and navmesh links when loaded from a baked cache.
+		std::shared_ptr<core::mappedfile> mCacheFile;
 
 		uint32_t mWorldDefinitionSize = 0;
 		float mWorldSize = 0.0f;
+		// Held exclusively while blockers change the obstruction map, navmesh and caches, and shared
+		// by the queries that read them. Heights, slopes, vertex blockers and props never change
+		// after loading and are read without it.
+		mutable core::rwlock mMutex;
 		void generateobstructionmap(float cellSize);
+		void buildobstructioncolumns();
+		void buildclearancefield();
+		void updateclearance(int x0, int y0, int x1, int y1);
+		void updateblockers(const core::rect& area);
+		void buildslopemaps();
+		bool testcellsobstructed(int x0, int y0, int x1, int y1)const;
+		// Unlocked forms of the public queries, for callers that already hold mMutex.
+		bool lineobstructed(float x0, float y0, float x1, float y1)const;
+		void linesobstructed(const float* x0, const float* y0, const float* x1, const float* y1, int count, bool* obstructed)const;
+		bool capsuleobstructed(float x0, float y0, float x1, float y1, float width)const;
+		float clearanceat(float x, float y)const;
+		bool segmentclear(float x0, float y0, float x1, float y1, float radius)const;
+		// navmesh2d::ClearanceTest over the clearance field, so only links that pass close to
+		// obstructions cast capsule rays.
+		void linkclearance(float x0, float y0, const float* x1, const float* y1, int count, navmesh2d::linkstate* states)const;
+		deque<vector3f> findpath(const vector3f& from, const vector3f& to, const std::function<bool(const vector3f&, const vector3f&)>& prArrived, pathmode mode, int* numRefined)const;
+		void initsize();
+		void buildpropindex();
+		void buildnavhierarchy();
 		void init();
 	public:
-		bool testrectinscenery(float x, float y, float w, float h, float radius = 1.f);
-		bool testpointinscenery(float x, float y);
-		bool testlineobstructed(float x0, float y0, float x1, float y1);
+		static constexpr float PropCellSize = 128.f;
+		static constexpr float ObstructionCellSize = 32.f;
+		static constexpr float NavCellSize = 64.f;
+		// Half width of the capsule navmesh links are cleared for.
+		static constexpr float NavCapsuleWidth = 40.f;
+		// Clearance saturates here, which keeps blocker updates local.
+		static constexpr float MaxClearance = 256.f;
+		bool testrectinscenery(float x, float y, float w, float h, float radius = 1.f)const;
+		bool testpointinscenery(float x, float y)const;
+		// True if any obstruction cell under the line is blocked, excluding a zero-length line's only cell.
+		bool testlineobstructed(float x0, float y0, float x1, float y1)const;
+		// Tests count lines (x0[i], y0[i]) -> (x1[i], y1[i]) at once, e.g. all of a navmesh node's capsule rays.
+		void testlinesobstructed(const float* x0, const float* y0, const float* x1, const float* y1, int count, bool* obstructed)const;
+		// Distance from the obstruction cell containing (x, y) to the nearest obstructed cell, between
+		// cell centres: 0 inside obstructions and at most MaxClearance.
+		float clearance(float x, float y)const;
+		// True if every point of the segment has at least radius clearance; radius <= MaxClearance.
+		bool testsegmentclearance(float x0, float y0, float x1, float y1, float radius)const;
+		// Casts the centre line and both edges of a capsule of half width 'width'.
+		bool testcapsuleobstructed(float x0, float y0, float x1, float y1, float width)const;
 		world(world&& o) = default;
 		world(const world& o) = default;
 		world& operator=(const world& o) = default;
 		world& operator=(world&& o) noexcept = default;
 
 		static std::shared_ptr<world> LoadFromFile(string_view filename);
+		// Baked world cache (.s2w): decoded maps, props, obstruction and clearance maps and navmesh links,
+		// loaded through a read-only mapping. Returns nullptr if the file is missing, stale, or
+		// doesn't match the sizes its own config implies.
+		static std::shared_ptr<world> LoadFromCache(string_view filename);
+		bool SaveCache(string_view filename)const;
 
 		string_view name()const;
 		const vector<worldprop>& props()const;
@@ -122,8 +244,45 @@ namespace s2 {
 		bool isblocked(float x, float y)const;
 		float terrainheight(float x, float y)const;
 		float terrainslope(float x, float y)const;
+		// Upper bound on terrainslope anywhere in the rect, from the coarsest mip level at which it
+		// spans no more than 4x4 entries.
+		float maxterrainslope(float x0, float y0, float x1, float y1)const;
 		vector<vector3f> navmeshlines()const;
 
-		deque<vector3f> pathfind(const vector3f& from, const vector3f& to, const std::function<bool(const vector3f&, const vector3f&)>& prArrived = nullptr)const;
+		// numRefined receives how many leading waypoints follow the grid; with pathmode::hierarchical
+		// the rest are cluster entrances and the path should be requested again before reaching them.
+		deque<vector3f> pathfind(const vector3f& from, const vector3f& to, const std::function<bool(const vector3f&, const vector3f&)>& prArrived = nullptr, pathmode mode = pathmode::flat, int* numRefined = nullptr)const;
+		// Runs every request as its own task on the pool; workers search with their thread's navsearch
+		// context over the shared, read-only navmesh. The world must outlive the returned futures.
+		vector<std::future<deque<vector3f>>> pathfind_batch(vector<pathrequest> requests, core::threadpool& pool = core::threadpool::Instance())const;
+		// pathfind towards anywhere within arrivalRadius of 'to', answered from an LRU cache of recent
+		// routes when the source and goal cells and radius bucket match a previous query.
+		deque<vector3f> cachedpathfind(const vector3f& from, const vector3f& to, float arrivalRadius, pathmode mode = pathmode::flat, int* numRefined = nullptr)const;
+		// Shortest flat path to whichever goal is cheapest to reach, in one multi-goal search rather
+		// than one pathfind per goal. goalIndex receives the index of the goal reached, or -1.
+		deque<vector3f> pathfindany(const vector3f& from, std::span<const vector3f> goals, int* goalIndex = nullptr)const;
+		pathcache::stats pathcachestats()const;
+		// Drops waypoints that the previous kept waypoint can reach in a straight line with a link's
+		// clearance. Only the first *numRefined waypoints are grid-accurate and get smoothed; the
+		// count is updated to match.
+		void smoothpath(deque<vector3f>& path, int* numRefined = nullptr)const;
+		// Flow field towards the navmesh cell containing goal; nullptr outside the grid. Building one
+		// takes tens of milliseconds, during which blocker changes wait.
+		std::shared_ptr<const flowfield> flowfieldto(const vector3f& goal)const;
+		// The flow field towards goal's cell if one is already built, else nullptr.
+		std::shared_ptr<const flowfield> cachedflowfield(const vector3f& goal)const;
+		// Navmesh cell containing pos, which flow fields are keyed by; -1 outside the grid.
+		int navcell(const vector3f& pos)const;
+		void clearpathcache();
+
+		// Stamps a blocker into the obstruction and clearance maps, replacing any blocker already
+		// registered under id, then relinks the navmesh nodes and hierarchy clusters around it,
+		// drops flow fields and the cached paths through it. Work scales with the footprint, not
+		// the map. Waits for queries running on other threads and holds off new ones until it's done.
+		void setblocker(int id, const dynamicblocker& blocker);
+		// Removes a blocker; the cells it covered revert to the map's own obstruction and any
+		// other blockers over them.
+		bool removeblocker(int id);
+		size_t numblockers()const;
 	};
 }